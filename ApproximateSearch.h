@@ -0,0 +1,160 @@
+#ifndef APPROXIMATESEARCH_H
+#define APPROXIMATESEARCH_H
+#include <vector>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include "FrozenSuffixAutomaton.h"
+using namespace std;
+
+// Bounded-error search of a frozen or mapped automaton: every distinct
+// substring of the text within distance k of a pattern.
+//
+// Every distinct substring is exactly one path from the root, so the search
+// is a depth-first walk of the automaton's DAG that carries the distance of
+// the path so far and abandons a path as soon as no extension of it can
+// come back within k. For Hamming distance that is a count of mismatches,
+// and the walk stops at the pattern's length. For Levenshtein distance it is
+// the row of the edit distance matrix between the path and every prefix of
+// the pattern, and a path is abandoned once the whole row exceeds k.
+//
+// Each edge followed is one step of work. A search given a budget of steps
+// stops when it runs out and returns false, keeping the hits found so far,
+// so a short pattern with a large k cannot stall the thread running it.
+
+// A distinct substring within distance of the pattern: the strings of length
+// length that reach state. Its positions are fa.PositionsFrom(state, length).
+template <class Index>
+struct ApproximateHit {
+	Index state;
+	Index length;
+	int distance;
+};
+
+// One occurrence of a hit in the text
+template <class Index>
+struct ApproximateOccurrence {
+	Index position;
+	Index length;
+	int distance;
+};
+
+// Walks the paths from the root depth first in lexicographic order, calling
+// visit(state, depth, c) for each edge followed, where c is the edge's label
+// and depth the length of the path it ends. The walk only goes on past state
+// if visit returns true. Every edge costs one step of budget. Returns false
+// if the budget ran out.
+template <class Index, class Visit>
+bool VisitPaths(const BasicFrozenView<Index>& fa, size_t& budget, Visit visit)
+{
+	struct Entry {
+		Index state;
+		Index depth;
+		char c;
+	};
+	vector<Entry> stack;
+	auto push = [&](Index i, Index depth)
+	{
+		// Reversed, so the smallest label is taken first
+		for (Index e = fa.offsets[i + 1]; e > fa.offsets[i]; e--)
+		{
+			stack.push_back({fa.targets[e - 1], depth + 1, fa.labels[e - 1]});
+		}
+	};
+	push(0, 0);
+	while (stack.size() > 0)
+	{
+		Entry x = stack.back();
+		stack.pop_back();
+		if (budget == 0) return false;
+		budget--;
+		if (visit(x.state, x.depth, x.c)) push(x.state, x.depth);
+	}
+	return true;
+}
+
+// Appends to hits the substrings of the text of p's length with at most k
+// mismatches against p, in lexicographic order. Returns false if the budget
+// ran out first.
+template <class Index>
+bool MismatchSearch(const BasicFrozenView<Index>& fa, string_view p, int k, vector<ApproximateHit<Index>>& hits, size_t budget = SIZE_MAX)
+{
+	Index m = p.size();
+	if (m == 0 || k < 0) return true;
+	// The mismatches of the current path up to each depth. A path is only
+	// visited after its parent, so entry depth - 1 is always its parent's.
+	vector<int> mismatches(m + 1, 0);
+	return VisitPaths(fa, budget, [&](Index i, Index depth, char c)
+	{
+		int d = mismatches[depth - 1] + (c != p[depth - 1]);
+		if (d > k) return false;
+		mismatches[depth] = d;
+		if (depth < m) return true;
+		hits.push_back({i, depth, d});
+		return false;
+	});
+}
+
+// Appends to hits the non-empty substrings of the text within Levenshtein
+// distance k of p, in lexicographic order. Returns false if the budget ran
+// out first.
+template <class Index>
+bool EditSearch(const BasicFrozenView<Index>& fa, string_view p, int k, vector<ApproximateHit<Index>>& hits, size_t budget = SIZE_MAX)
+{
+	if (k < 0) return true;
+	size_t m = p.size();
+	// A path more than k longer than p is more than k edits from it, so an
+	// empty p with k of 0 has no non-empty hit and needs no steps
+	size_t maxdepth = m + k;
+	if (maxdepth == 0) return true;
+	// rows[depth][j] is the distance between the current path up to depth
+	// and p[0, j), kept for every depth as for MismatchSearch
+	size_t width = m + 1;
+	vector<int> rows(width * (maxdepth + 1));
+	for (size_t j = 0; j <= m; j++)
+	{
+		rows[j] = j;
+	}
+	return VisitPaths(fa, budget, [&](Index i, Index depth, char c)
+	{
+		const int* above = rows.data() + (depth - 1) * width;
+		int* row = rows.data() + depth * width;
+		row[0] = above[0] + 1;
+		int best = row[0];
+		for (size_t j = 1; j <= m; j++)
+		{
+			row[j] = min({above[j - 1] + (c != p[j - 1]), above[j] + 1, row[j - 1] + 1});
+			best = min(best, row[j]);
+		}
+		if (row[m] <= k) hits.push_back({i, depth, row[m]});
+		return best <= k && depth < maxdepth;
+	});
+}
+
+// Appends to occurrences every occurrence of the hits, in increasing order
+// of position and then length. The positions come from each hit's link
+// subtree, and each costs one step of budget. Returns false if the budget
+// ran out first.
+template <class Index>
+bool ApproximatePositions(const BasicFrozenView<Index>& fa, const vector<ApproximateHit<Index>>& hits, vector<ApproximateOccurrence<Index>>& occurrences, size_t budget = SIZE_MAX)
+{
+	size_t from = occurrences.size();
+	bool complete = true;
+	for (auto& h : hits)
+	{
+		fa.ForEachPositionFrom(h.state, h.length, [&](Index i)
+		{
+			if (budget == 0) return complete = false;
+			budget--;
+			occurrences.push_back({i, h.length, h.distance});
+			return true;
+		});
+		if (!complete) break;
+	}
+	sort(occurrences.begin() + from, occurrences.end(), [](const ApproximateOccurrence<Index>& a, const ApproximateOccurrence<Index>& b)
+	{
+		return a.position != b.position ? a.position < b.position : a.length < b.length;
+	});
+	return complete;
+}
+#endif
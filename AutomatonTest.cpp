@@ -0,0 +1,1151 @@
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <map>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include "ParallelBuild.h"
+#include "CompactDawg.h"
+#include "ApproximateSearch.h"
+#include "PositionIndex.h"
+#include "MatchingStatistics.h"
+#include "SubstringStatistics.h"
+#include "SuffixAutomatonImage.h"
+using namespace std;
+
+// Checks the components that PositionsTest does not reach against slower,
+// obviously correct answers: the sequential build, or a scan of the text.
+// Every input is generated from a fixed seed, so a failure always repeats.
+
+int failures = 0;
+
+void Check(bool passed, const string& what)
+{
+	if (passed) cout << "PASSED: " << what << endl;
+	else
+	{
+		cout << "FAILURE: " << what << endl;
+		failures++;
+	}
+}
+
+// A string of n characters drawn from the first sigma letters of "abcd"
+string RandomText(mt19937& g, int n, int sigma)
+{
+	string s;
+	for (int i = 0; i < n; i++)
+	{
+		s.push_back("abcd"[g() % sigma]);
+	}
+	return s;
+}
+
+// Up to limit substrings of the texts of at most 4 characters, and some
+// strings that probably occur in none of them
+vector<string> SamplePatterns(mt19937& g, const vector<string>& texts, size_t limit)
+{
+	set<string> found;
+	for (auto& t : texts)
+	{
+		for (size_t i = 0; i < t.size(); i++)
+		{
+			for (size_t k = 1; k <= 4 && i + k <= t.size(); k++)
+			{
+				found.insert(t.substr(i, k));
+			}
+		}
+	}
+	vector<string> p(found.begin(), found.end());
+	shuffle(p.begin(), p.end(), g);
+	if (p.size() > limit) p.resize(limit);
+	for (int k = 0; k < 20; k++)
+	{
+		p.push_back(RandomText(g, 1 + g() % 6, 4));
+	}
+	return p;
+}
+
+// The positions of p in s, found by trying every one
+vector<int64_t> ScanPositions(const string& s, const string& p)
+{
+	vector<int64_t> found;
+	for (size_t i = s.find(p); i != string::npos; i = s.find(p, i + 1))
+	{
+		found.push_back(i);
+	}
+	return found;
+}
+
+template <class Index>
+vector<int64_t> Widen(const vector<Index>& v)
+{
+	return vector<int64_t>(v.begin(), v.end());
+}
+
+// Random substrings of s of up to 40 characters, some with one character
+// changed, and random strings of the given alphabet
+vector<string> CutPatterns(mt19937& g, const string& s, const string& alphabet, int count)
+{
+	vector<string> p;
+	for (int k = 0; k < count; k++)
+	{
+		string x;
+		if (s.empty() || g() % 5 == 0)
+		{
+			for (int l = 1 + g() % 4; l > 0; l--)
+			{
+				x.push_back(alphabet[g() % alphabet.size()]);
+			}
+		}
+		else
+		{
+			size_t a = g() % s.size();
+			x = s.substr(a, 1 + g() % min<size_t>(s.size() - a, 40));
+			if (g() % 6 == 0) x[g() % x.size()] = alphabet[g() % alphabet.size()];
+		}
+		p.push_back(x);
+	}
+	return p;
+}
+
+template <class Store>
+size_t EdgeCount(const BasicSuffixAutomaton<Store>& sa)
+{
+	size_t edges = 0;
+	for (typename Store::IndexType i = 0; i < sa.size(); i++)
+	{
+		edges += sa.transitions.Degree(i);
+	}
+	return edges;
+}
+
+// A string of n characters drawn from the given bytes
+string RandomBytes(mt19937& g, int n, const string& bytes)
+{
+	string s;
+	for (int i = 0; i < n; i++)
+	{
+		s.push_back(bytes[g() % bytes.size()]);
+	}
+	return s;
+}
+
+// 48 bytes, 8 of them at or above 0x80, so the root and its neighbours have
+// enough labels for the 16- and 32-wide FindLabel paths
+string WideAlphabet()
+{
+	string bytes;
+	for (int c = 0; c < 40; c++)
+	{
+		bytes.push_back('0' + c);
+	}
+	for (int c = 0; c < 8; c++)
+	{
+		bytes.push_back((char)(0x80 + 16 * c + 15));
+	}
+	return bytes;
+}
+
+// An automaton built from a string and one built by extend must both answer
+// as a scan of the text does, whatever store holds their transitions
+template <class Store>
+bool StoreMatchesScan(mt19937& g, const string& s, const string& alphabet)
+{
+	BasicSuffixAutomaton<Store> built(s);
+	BasicSuffixAutomaton<Store> extended;
+	for (auto& c : s)
+	{
+		extended.extend(c);
+	}
+	extended.ComputeOccurrences();
+	bool same = built.size() == extended.size();
+	for (auto& p : CutPatterns(g, s, alphabet, 100))
+	{
+		vector<int64_t> found = ScanPositions(s, p);
+		for (auto* sa : {&built, &extended})
+		{
+			same = same && sa->contains(p) == !found.empty() && (size_t)sa->count(p) == found.size() && Widen(sa->positions(p)) == found;
+		}
+	}
+	return same;
+}
+
+template <class Store>
+void TestStore(const string& name)
+{
+	mt19937 g(11);
+	string wide = WideAlphabet();
+	bool same = true;
+	for (int k = 0; k < 20; k++)
+	{
+		same = same && StoreMatchesScan<Store>(g, RandomText(g, g() % 200, 1 + k % 4), "abcd");
+		same = same && StoreMatchesScan<Store>(g, RandomBytes(g, g() % 1000, wide.substr(0, 1 + g() % wide.size())), wide);
+	}
+	Check(same, name + " built from a string and by extend matches a scan of the text");
+}
+
+// ShrinkToFit must keep every used byte, release rather than add reserved
+// ones, and leave an automaton that answers and extends as before
+template <class Store>
+void TestShrinkToFit(const string& name)
+{
+	mt19937 g(16);
+	string wide = WideAlphabet();
+	bool smaller = true;
+	bool same = true;
+	for (int k = 0; k < 20; k++)
+	{
+		string s = k % 2 == 0 ? RandomText(g, g() % 1000, 1 + k % 4) : RandomBytes(g, g() % 1000, wide);
+		BasicSuffixAutomaton<Store> sa(s);
+		MemoryUsage before = sa.Memory().total();
+		sa.ShrinkToFit();
+		MemoryUsage after = sa.Memory().total();
+		smaller = smaller && after.used == before.used && after.reserved <= before.reserved && after.used <= after.reserved;
+		string more = k % 2 == 0 ? RandomText(g, g() % 100, 1 + k % 4) : RandomBytes(g, g() % 100, wide);
+		for (auto& p : CutPatterns(g, s, wide, 50))
+		{
+			same = same && (size_t)sa.count(p) == ScanPositions(s, p).size() && Widen(sa.positions(p)) == ScanPositions(s, p);
+		}
+		sa.append(more);
+		sa.ComputeOccurrences();
+		s += more;
+		for (auto& p : CutPatterns(g, s, wide, 50))
+		{
+			same = same && (size_t)sa.count(p) == ScanPositions(s, p).size() && Widen(sa.positions(p)) == ScanPositions(s, p);
+		}
+	}
+	Check(smaller, "ShrinkToFit on " + name + " keeps the used bytes and does not reserve more");
+	Check(same, "Queries on " + name + " match a scan after ShrinkToFit and after extending it");
+}
+
+// An AlphabetStore must widen its rows as bytes are added, turn sparse once
+// the alphabet outgrows MaxDense, and fail at once on a byte it has not seen
+template <class Store>
+bool AlphabetStoreMatchesScan(mt19937& g, const string& prefix, const string& s, const string& alphabet)
+{
+	BasicSuffixAutomaton<Store> sa{Store(Alphabet::Of(prefix))};
+	sa.append(s);
+	sa.ComputeOccurrences();
+	const Store& store = sa.transitions;
+	set<char> bytes(s.begin(), s.end());
+	bool same = store.alphabet.size() == (int)bytes.size();
+	same = same && (bytes.size() > 16 ? store.width == 0 : store.width >= (int)bytes.size() && store.width <= 16);
+	// The bytes of the prefix come first in increasing order, then the rest
+	// in the order the text first used them
+	set<unsigned char> sorted(prefix.begin(), prefix.end());
+	vector<unsigned char> order(sorted.begin(), sorted.end());
+	for (auto& c : s)
+	{
+		if (find(order.begin(), order.end(), (unsigned char)c) == order.end()) order.push_back(c);
+	}
+	same = same && store.alphabet.bytes == order;
+	for (auto& p : CutPatterns(g, s, alphabet, 100))
+	{
+		vector<int64_t> found = ScanPositions(s, p);
+		same = same && sa.contains(p) == !found.empty() && (size_t)sa.count(p) == found.size() && Widen(sa.positions(p)) == found;
+	}
+	for (auto& c : alphabet)
+	{
+		if (bytes.count(c)) continue;
+		for (typename Store::IndexType i = 0; i < sa.size(); i++)
+		{
+			same = same && store.GetTransition(i, c) == -1;
+		}
+	}
+	return same;
+}
+
+void TestAlphabetStore()
+{
+	mt19937 g(13);
+	string wide = WideAlphabet();
+	bool same = true;
+	for (int k = 0; k < 60; k++)
+	{
+		// From 1 to 24 bytes, on both sides of the starting width of 4 and of
+		// MaxDense, in a store sized for none, some or all of them
+		string bytes = wide.substr(g() % 24, 1 + k % 24);
+		string s = RandomBytes(g, g() % 500, bytes);
+		string prefix = k % 3 == 0 ? "" : s.substr(0, k % 3 == 1 ? s.size() / 2 : s.size());
+		same = same && AlphabetStoreMatchesScan<AlphabetStore<>>(g, prefix, s, wide);
+	}
+	Check(same, "AlphabetStore widens, turns sparse and rejects unseen bytes as a scan of the text expects");
+}
+
+// FindLabel must find the first match at every length, on both sides of the
+// 16- and 32-label blocks
+bool FindLabelMatchesScan(mt19937& g)
+{
+	string wide = WideAlphabet();
+	for (int n = 0; n <= 80; n++)
+	{
+		string labels = RandomBytes(g, n, wide);
+		for (auto& c : wide)
+		{
+			size_t at = labels.find(c);
+			if (FindLabel(labels.data(), n, c) != (at == string::npos ? -1 : (int)at)) return false;
+		}
+	}
+	return true;
+}
+
+// A freed block is handed out again for its own size class only
+bool ArenaReusesBlocks()
+{
+	EdgeArena<int> arena;
+	int a = arena.Allocate(0);
+	int b = arena.Allocate(1);
+	arena.Free(a, 0);
+	arena.Free(b, 1);
+	int c = arena.Allocate(1);
+	int d = arena.Allocate(0);
+	int e = arena.Allocate(0);
+	return c == b && d == a && e != a && e != b;
+}
+
+// count must match a scan from construction on, report -1 once text is
+// appended, and match a scan of the longer text once recounted
+template <class Index>
+void TestCount(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(9);
+	bool built = true;
+	bool stale = true;
+	bool recounted = true;
+	for (int k = 0; k < 100; k++)
+	{
+		string s = RandomText(g, g() % 300, 1 + k % 4);
+		BasicSuffixAutomaton<Store> sa(s);
+		const BasicSuffixAutomaton<Store>& queried = sa;
+		for (auto& p : SamplePatterns(g, {s}, 100))
+		{
+			built = built && (size_t)queried.count(p) == ScanPositions(s, p).size();
+		}
+		string more = RandomText(g, 1 + g() % 50, 1 + k % 4);
+		sa.append(more);
+		s += more;
+		vector<string> patterns = SamplePatterns(g, {s}, 100);
+		for (auto& p : patterns)
+		{
+			stale = stale && sa.count(p) == (Index)-1;
+		}
+		sa.ComputeOccurrences();
+		for (auto& p : patterns)
+		{
+			recounted = recounted && (size_t)sa.count(p) == ScanPositions(s, p).size();
+		}
+	}
+	Check(built, "count with " + type + " indices matches a scan of the text");
+	Check(stale, "count with " + type + " indices reports -1 after appending");
+	Check(recounted, "count with " + type + " indices matches a scan of the longer text once recounted");
+}
+
+// The states the suffixes of s reach, which are exactly the terminal ones
+template <class Automaton>
+set<int64_t> SuffixStates(const Automaton& sa, const string& s)
+{
+	set<int64_t> states;
+	for (size_t i = 0; i <= s.size(); i++)
+	{
+		states.insert(sa.Walk(string_view(s).substr(i)));
+	}
+	return states;
+}
+
+// Appending to a built automaton must leave it answering as a scan of the
+// longer text does, and a freeze taken after appending must agree
+template <class Index>
+void TestAppend(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(14);
+	bool positions = true;
+	bool terminals = true;
+	bool frozen = true;
+	bool stale = true;
+	for (int k = 0; k < 100; k++)
+	{
+		string s = RandomText(g, g() % 200, 1 + k % 4);
+		BasicSuffixAutomaton<Store> sa(s);
+		for (int round = 0; round < 3; round++)
+		{
+			string more = RandomText(g, g() % 100, 1 + k % 4);
+			if (g() % 2) sa.append(more);
+			else
+			{
+				for (auto& c : more)
+				{
+					sa.extend(c);
+				}
+			}
+			s += more;
+			stale = stale && (more.empty() && round == 0 ? (size_t)sa.count("a") == ScanPositions(s, "a").size() : sa.count("a") == (Index)-1);
+			// Frozen before the terminal flags are brought up to date
+			BasicFrozenSuffixAutomaton<Index> fa(sa);
+			BasicFrozenView<Index> v = fa.View();
+			set<int64_t> suffixes = SuffixStates(sa, s);
+			set<int64_t> marked;
+			for (Index i = 0; i < v.n; i++)
+			{
+				if (v.IsTerminal(i)) marked.insert(i);
+			}
+			frozen = frozen && marked == suffixes;
+			sa.MarkTerminals();
+			marked.clear();
+			for (Index i = 0; i < sa.size(); i++)
+			{
+				if (sa.terminal[i]) marked.insert(i);
+			}
+			terminals = terminals && marked == suffixes;
+			for (auto& p : SamplePatterns(g, {s}, 50))
+			{
+				vector<int64_t> found = ScanPositions(s, p);
+				vector<int64_t> visited;
+				sa.ForEachPosition(p, [&](Index i)
+				{
+					visited.push_back(i);
+					return true;
+				});
+				sort(visited.begin(), visited.end());
+				Index first = found.empty() ? -1 : found[0];
+				positions = positions && Widen(sa.positions(p)) == found && visited == found && sa.first(p) == first;
+				frozen = frozen && Widen(v.positions(p)) == found && (size_t)v.count(p) == found.size();
+			}
+		}
+	}
+	Check(positions, "positions and ForEachPosition with " + type + " indices match a scan after appending");
+	Check(terminals, "MarkTerminals with " + type + " indices marks the suffixes of the text after appending");
+	Check(frozen, "Freezing after appending with " + type + " indices matches a scan and marks the suffixes");
+	Check(stale, "count with " + type + " indices goes stale once text is appended");
+}
+
+// In-order position queries must list the sorted scan, and stopping early
+// or asking for the first k must give a prefix of it
+template <class Automaton>
+bool InOrderMatchesScan(mt19937& g, const Automaton& a, const string& s, const string& p)
+{
+	typedef typename Automaton::Index Index;
+	vector<int64_t> found = ScanPositions(s, p);
+	vector<int64_t> all;
+	a.ForEachPositionInOrder(p, [&](Index i)
+	{
+		all.push_back(i);
+		return true;
+	});
+	size_t stop = g() % (found.size() + 1);
+	vector<int64_t> some;
+	a.ForEachPositionInOrder(p, [&](Index i)
+	{
+		some.push_back(i);
+		return some.size() < stop;
+	});
+	vector<int64_t> prefix(found.begin(), found.begin() + min(max<size_t>(stop, 1), found.size()));
+	bool same = all == found && some == prefix;
+	for (size_t k : {(size_t)0, (size_t)1, stop, found.size(), found.size() + 1 + g() % 5})
+	{
+		vector<int64_t> want(found.begin(), found.begin() + min(k, found.size()));
+		same = same && Widen(a.FirstPositions(p, k)) == want;
+	}
+	return same;
+}
+
+template <class Index>
+void TestPositionsInOrder(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(15);
+	bool live = true;
+	bool frozen = true;
+	for (int k = 0; k < 60; k++)
+	{
+		string s = RandomText(g, g() % 500, 1 + k % 3);
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		for (auto& p : SamplePatterns(g, {s}, 50))
+		{
+			live = live && InOrderMatchesScan(g, sa, s, p);
+			frozen = frozen && InOrderMatchesScan(g, fa, s, p);
+		}
+	}
+	Check(live, "ForEachPositionInOrder and FirstPositions with " + type + " indices match a sorted scan");
+	Check(frozen, "Frozen ForEachPositionInOrder and FirstPositions with " + type + " indices match a sorted scan");
+}
+
+// A generalized automaton must report each document's occurrences as a
+// scan of every document does
+template <class Index>
+void TestGeneralized(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(10);
+	bool same = true;
+	for (int k = 0; k < 60; k++)
+	{
+		vector<string> docs;
+		for (int d = 1 + g() % 8; d > 0; d--)
+		{
+			docs.push_back(g() % 5 == 0 ? "" : RandomText(g, g() % 100, 1 + k % 4));
+		}
+		BasicGeneralizedSuffixAutomaton<Store> corpus(docs);
+		for (auto& p : SamplePatterns(g, docs, 100))
+		{
+			vector<pair<int, int64_t>> want;
+			vector<int> wantdocs;
+			for (size_t d = 0; d < docs.size(); d++)
+			{
+				for (int64_t i : ScanPositions(docs[d], p))
+				{
+					want.push_back({d, i});
+				}
+				if (!want.empty() && want.back().first == (int)d) wantdocs.push_back(d);
+			}
+			vector<pair<int, int64_t>> got;
+			for (auto& [d, i] : corpus.positions(p))
+			{
+				got.push_back({d, i});
+			}
+			same = same && got == want && corpus.contains(p) == !want.empty() && (size_t)corpus.count(p) == want.size();
+			same = same && corpus.DocumentFrequency(p) == (int)wantdocs.size() && corpus.documentsof(p) == wantdocs;
+		}
+	}
+	Check(same, "GeneralizedSuffixAutomaton with " + type + " indices matches a scan of every document");
+}
+
+// ParallelBuild must give the automaton AddDocument gives, up to the
+// numbering of its states
+template <class Index>
+void TestParallelBuild(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(1);
+	vector<vector<string>> corpora = {{}, {""}, {"", "", ""}, {"abcab"}, {"", "abab", "", "ba", ""}, {"aaaa", "aaaa", "aa"}};
+	for (int k = 0; k < 4; k++)
+	{
+		vector<string> docs;
+		int count = 2 + g() % 20;
+		for (int d = 0; d < count; d++)
+		{
+			docs.push_back(g() % 4 == 0 ? "" : RandomText(g, g() % 300, 1 + k % 4));
+		}
+		corpora.push_back(docs);
+	}
+	vector<string> large;
+	for (int d = 0; d < 6; d++)
+	{
+		large.push_back(RandomText(g, 3000, 3));
+	}
+	corpora.push_back(large);
+	for (int threads : {1, 2, 3, 8})
+	{
+		QueryPool pool(threads);
+		bool same = true;
+		for (auto& docs : corpora)
+		{
+			BasicGeneralizedSuffixAutomaton<Store> sequential(docs);
+			BasicGeneralizedSuffixAutomaton<Store> parallel = ParallelBuild<Store>(pool, docs);
+			same = same && sequential.sa.size() == parallel.sa.size() && EdgeCount(sequential.sa) == EdgeCount(parallel.sa);
+			for (auto& p : SamplePatterns(g, docs, 300))
+			{
+				same = same && sequential.count(p) == parallel.count(p) && sequential.positions(p) == parallel.positions(p) && sequential.DocumentFrequency(p) == parallel.DocumentFrequency(p);
+			}
+		}
+		Check(same, "ParallelBuild on " + to_string(threads) + " threads with " + type + " indices matches AddDocument");
+	}
+}
+
+// CompactDawg must find every occurrence a scan of the text finds, including
+// those cut off by the end of the text
+template <class Index>
+void TestCompactDawg(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(3);
+	vector<pair<string, string>> texts;
+	for (int k = 0; k < 300; k++)
+	{
+		texts.push_back({RandomText(g, g() % 60, 1 + k % 3), "abc"});
+	}
+	// The most states and a chain ended by a node
+	string chain = "a" + string(2000, 'b');
+	texts.push_back({chain, "abc"});
+	texts.push_back({chain + "c", "abc"});
+	// Bytes that are negative as char
+	string high = "\x80\xfe\xff" "a";
+	for (int k = 0; k < 20; k++)
+	{
+		string s;
+		for (int n = g() % 500; n > 0; n--)
+		{
+			s.push_back(high[g() % (1 + k % 4)]);
+		}
+		texts.push_back({s, high});
+	}
+	bool same = true;
+	for (auto& [s, alphabet] : texts)
+	{
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicCompactDawg<Index> dawg(sa, s);
+		for (auto& p : CutPatterns(g, s, alphabet, 60))
+		{
+			vector<int64_t> found = ScanPositions(s, p);
+			Index first = found.empty() ? -1 : found[0];
+			same = same && dawg.contains(p) == !found.empty() && dawg.first(p) == first && (size_t)dawg.count(p) == found.size() && Widen(dawg.positions(p)) == found;
+		}
+	}
+	Check(same, "CompactDawg with " + type + " indices matches a scan of the text");
+}
+
+// Every slice of a wavelet matrix must count and list the values in a range
+// as sorting the slice does
+template <class Index>
+bool WaveletMatchesSort(mt19937& g)
+{
+	int n = g() % 200;
+	Index maxvalue = g() % 3 == 0 ? 1 : g() % 1000;
+	vector<Index> values;
+	for (int i = 0; i < n; i++)
+	{
+		values.push_back(g() % (maxvalue + 1));
+	}
+	BasicWaveletMatrix<Index> w(values, maxvalue);
+	for (int q = 0; q < 50; q++)
+	{
+		Index l = g() % (n + 1);
+		Index r = l + g() % (n - l + 1);
+		int64_t lo = (int64_t)(g() % (maxvalue + 3)) - 1;
+		int64_t hi = lo + g() % (maxvalue + 3);
+		int64_t skip = g() % 4 == 0 ? g() % (r - l + 2) : 0;
+		vector<Index> want;
+		for (Index i = l; i < r; i++)
+		{
+			if (lo <= (int64_t)values[i] && (int64_t)values[i] < hi) want.push_back(values[i]);
+		}
+		sort(want.begin(), want.end());
+		if ((size_t)w.CountRange(l, r, lo, hi) != want.size()) return false;
+		want.erase(want.begin(), want.begin() + min<size_t>(skip, want.size()));
+		vector<Index> got;
+		w.Enumerate(l, r, lo, hi, skip, [&](Index v)
+		{
+			got.push_back(v);
+			return true;
+		});
+		if (got != want) return false;
+	}
+	return true;
+}
+
+// PositionIndex must page and range positions as filtering a scan does
+template <class Index>
+void TestPositionIndex(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(5);
+	bool wavelet = true;
+	for (int k = 0; k < 100; k++)
+	{
+		wavelet = wavelet && WaveletMatchesSort<Index>(g);
+	}
+	Check(wavelet, "WaveletMatrix with " + type + " indices matches sorting");
+	bool same = true;
+	for (int k = 0; k < 40; k++)
+	{
+		string s = RandomText(g, k < 30 ? g() % 100 : 2000, 1 + k % 3);
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		BasicFrozenView<Index> v = fa.View();
+		BasicPositionIndex<Index> index(v);
+		Index n = s.size();
+		for (auto& p : SamplePatterns(g, {s}, 100))
+		{
+			vector<int64_t> found = ScanPositions(s, p);
+			same = same && Widen(index.positions(v, p)) == found;
+			Index lo = g() % (n + 2);
+			Index hi = g() % 5 == 0 ? numeric_limits<Index>::max() : lo + g() % (n + 2);
+			Index offset = g() % 3 == 0 ? g() % (found.size() + 2) : 0;
+			Index limit = g() % 3 == 0 ? g() % (found.size() + 2) : numeric_limits<Index>::max();
+			vector<int64_t> want;
+			for (int64_t x : found)
+			{
+				if (lo <= x && (hi == numeric_limits<Index>::max() || x < (int64_t)hi)) want.push_back(x);
+			}
+			same = same && (size_t)index.count(v, p, lo, hi) == want.size();
+			want.erase(want.begin(), want.begin() + min<size_t>(offset, want.size()));
+			if (want.size() > (size_t)limit) want.resize(limit);
+			same = same && Widen(index.positions(v, p, offset, limit, lo, hi)) == want;
+		}
+	}
+	Check(same, "PositionIndex with " + type + " indices matches a scan of the text");
+}
+
+// MatchingStatistics must give, after every character of a text fed in
+// random chunks, the longest substring ending there that a scan finds in
+// the reference
+template <class Index>
+void TestMatchingStatistics(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(6);
+	bool same = true;
+	bool longest = true;
+	for (int k = 0; k < 200; k++)
+	{
+		string reference = RandomText(g, g() % 80, 1 + k % 3);
+		string text = RandomText(g, g() % 80, 1 + (k + 1) % 4);
+		BasicSuffixAutomaton<Store> sa(reference);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		BasicFrozenView<Index> v = fa.View();
+		BasicMatchingStatistics<Index> m(v);
+		// Stream the text twice to check that Reset starts over
+		for (int pass = 0; pass < 2; pass++)
+		{
+			m.Reset();
+			size_t best = 0;
+			int64_t fed = 0;
+			for (size_t at = 0; at < text.size(); )
+			{
+				size_t chunk = min<size_t>(1 + g() % 10, text.size() - at);
+				m.Feed(string_view(text).substr(at, chunk), [&](int64_t position, Index length, Index state)
+				{
+					size_t want = 0;
+					while (want < (size_t)position + 1 && reference.find(text.substr(position - want, want + 1)) != string::npos)
+					{
+						want++;
+					}
+					best = max(best, want);
+					string match = text.substr(position - want + 1, want);
+					same = same && position == fed++ && (size_t)length == want && v.Walk(match) == state;
+				});
+				at += chunk;
+			}
+			BasicCommonSubstring<Index> c = m.longest;
+			longest = longest && (size_t)c.length == best && text.substr(c.textstart, c.length) == reference.substr(c.referencestart, c.length);
+		}
+		BasicCommonSubstring<Index> c = LongestCommonSubstring(v, text);
+		longest = longest && c.length == m.longest.length && c.textstart == m.longest.textstart && c.referencestart == m.longest.referencestart;
+	}
+	Check(same, "MatchingStatistics with " + type + " indices matches a scan of the reference");
+	Check(longest, "LongestCommonSubstring with " + type + " indices matches a scan of the reference");
+}
+
+// SubstringStatistics must count and rank the distinct substrings as the
+// sorted set of every substring does
+template <class Index>
+void TestSubstringStatistics(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(7);
+	bool distinct = true;
+	bool prefix = true;
+	bool kth = true;
+	for (int k = 0; k < 150; k++)
+	{
+		string s = k == 0 ? string(300, 'a') : RandomText(g, g() % 60, 1 + k % 4);
+		set<string> substrings;
+		for (size_t a = 0; a < s.size(); a++)
+		{
+			for (size_t l = 1; a + l <= s.size(); l++)
+			{
+				substrings.insert(s.substr(a, l));
+			}
+		}
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		BasicFrozenView<Index> v = fa.View();
+		SubstringStatistics stats(v);
+		distinct = distinct && (size_t)stats.distinct() == substrings.size();
+		vector<string> patterns = SamplePatterns(g, {s}, 50);
+		patterns.push_back("");
+		for (auto& p : patterns)
+		{
+			size_t want = 0;
+			for (auto& x : substrings)
+			{
+				want += x.compare(0, p.size(), p) == 0;
+			}
+			prefix = prefix && (size_t)stats.DistinctWithPrefix(v, p) == want;
+		}
+		int64_t rank = 1;
+		for (auto& x : substrings)
+		{
+			kth = kth && stats.KthSubstring(v, rank++) == x;
+		}
+		kth = kth && stats.KthSubstring(v, 0) == "" && stats.KthSubstring(v, rank) == "";
+	}
+	Check(distinct, "SubstringStatistics with " + type + " indices counts the distinct substrings");
+	Check(prefix, "DistinctWithPrefix with " + type + " indices matches the set of substrings");
+	Check(kth, "KthSubstring with " + type + " indices matches the sorted set of substrings");
+}
+
+// The Levenshtein distance between a and b
+int EditDistance(const string& a, const string& b)
+{
+	vector<int> row(b.size() + 1);
+	for (size_t j = 0; j <= b.size(); j++)
+	{
+		row[j] = j;
+	}
+	for (size_t i = 1; i <= a.size(); i++)
+	{
+		int diagonal = row[0];
+		row[0] = i;
+		for (size_t j = 1; j <= b.size(); j++)
+		{
+			int above = row[j];
+			row[j] = min({diagonal + (a[i - 1] != b[j - 1]), above + 1, row[j - 1] + 1});
+			diagonal = above;
+		}
+	}
+	return row[b.size()];
+}
+
+// One approximate search, against every substring of s. Each hit must be a
+// distinct substring within k of p, in lexicographic order, and a search cut
+// short by its budget must keep the hits it found before.
+template <class Index, class Search>
+bool SameAsScan(const BasicFrozenView<Index>& v, const string& s, const string& p, int k, bool hamming, Search search)
+{
+	map<string, int> want;
+	set<tuple<int64_t, int64_t, int>> wantoccurrences;
+	for (size_t a = 0; a < s.size(); a++)
+	{
+		for (size_t l = 1; a + l <= s.size(); l++)
+		{
+			string x = s.substr(a, l);
+			int d = 0;
+			if (!hamming) d = EditDistance(x, p);
+			else if (l != p.size()) continue;
+			else
+			{
+				for (size_t j = 0; j < l; j++)
+				{
+					d += x[j] != p[j];
+				}
+			}
+			if (d > k) continue;
+			want[x] = d;
+			wantoccurrences.insert({a, l, d});
+		}
+	}
+	vector<ApproximateHit<Index>> hits;
+	if (!search(hits, SIZE_MAX)) return false;
+	map<string, int> got;
+	vector<string> order;
+	for (auto& h : hits)
+	{
+		string x = s.substr(v.firstpos[h.state] - h.length + 1, h.length);
+		got[x] = h.distance;
+		order.push_back(x);
+	}
+	if (got != want || order.size() != want.size() || !is_sorted(order.begin(), order.end())) return false;
+	vector<ApproximateOccurrence<Index>> occurrences;
+	if (!ApproximatePositions(v, hits, occurrences)) return false;
+	vector<tuple<int64_t, int64_t, int>> gotoccurrences;
+	for (auto& o : occurrences)
+	{
+		gotoccurrences.push_back({o.position, o.length, o.distance});
+	}
+	if (gotoccurrences != vector<tuple<int64_t, int64_t, int>>(wantoccurrences.begin(), wantoccurrences.end())) return false;
+	// Budgets too small to finish give up part way, and keep the hits so far
+	for (size_t budget = 0; ; budget = 2 * budget + 1)
+	{
+		vector<ApproximateHit<Index>> few;
+		bool finished = search(few, budget);
+		if (few.size() > hits.size()) return false;
+		for (size_t i = 0; i < few.size(); i++)
+		{
+			if (few[i].state != hits[i].state || few[i].length != hits[i].length || few[i].distance != hits[i].distance) return false;
+		}
+		if (finished)
+		{
+			if (few.size() != hits.size()) return false;
+			break;
+		}
+	}
+	for (size_t budget : {size_t(0), occurrences.size() / 2, occurrences.size()})
+	{
+		vector<ApproximateOccurrence<Index>> few;
+		bool finished = ApproximatePositions(v, hits, few, budget);
+		if (finished != (budget == occurrences.size()) || few.size() != budget) return false;
+		for (auto& o : few)
+		{
+			if (!wantoccurrences.count({o.position, o.length, o.distance})) return false;
+		}
+	}
+	return true;
+}
+
+// MismatchSearch and EditSearch must find what a scan of every substring
+// finds, including when k reaches the length of the pattern
+template <class Index>
+void TestApproximateSearch(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	mt19937 g(4);
+	bool hamming = true;
+	bool edit = true;
+	for (int round = 0; round < 800; round++)
+	{
+		string s = RandomText(g, g() % 30, 1 + round % 4);
+		string p = RandomText(g, g() % 6, 1 + round % 4);
+		int k = (int)(g() % (p.size() + 3)) - 1;
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		BasicFrozenView<Index> v = fa.View();
+		hamming = hamming && SameAsScan(v, s, p, k, true, [&](vector<ApproximateHit<Index>>& hits, size_t budget) { return MismatchSearch(v, p, k, hits, budget); });
+		edit = edit && SameAsScan(v, s, p, k, false, [&](vector<ApproximateHit<Index>>& hits, size_t budget) { return EditSearch(v, p, k, hits, budget); });
+		// No edge can be within 0 edits of an empty pattern, so none is followed
+		vector<ApproximateHit<Index>> none;
+		edit = edit && EditSearch(v, "", 0, none, 0) && none.empty();
+	}
+	Check(hamming, "MismatchSearch with " + type + " indices matches a scan of the text");
+	Check(edit, "EditSearch with " + type + " indices matches a scan of the text");
+}
+
+string ReadFile(const string& path)
+{
+	ifstream in(path, ios::binary);
+	stringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+void WriteFile(const string& path, const string& bytes)
+{
+	ofstream out(path, ios::binary);
+	out << bytes;
+}
+
+// Overwrites the k-th value of section i of the image with x
+template <class Index>
+string Corrupt(string image, int i, size_t k, Index x)
+{
+	ImageHeader h;
+	memcpy(&h, image.data(), sizeof(h));
+	size_t n = h.states;
+	size_t words = BasicFrozenView<Index>::Words(n);
+	const size_t w = sizeof(Index);
+	size_t sizes[] = {w * n, w * n, w * n, w * n, 8 * words, 8 * words, w * (n + 1), w * (n + 1), w * (n - 1), w * h.edges, h.edges, h.textlen};
+	size_t at = ImageAlign(sizeof(ImageHeader));
+	for (int j = 0; j < i; j++)
+	{
+		at += ImageAlign(sizes[j]);
+	}
+	memcpy(&image[at + k * w], &x, w);
+	return image;
+}
+
+// A saved image must map back to an automaton that answers as a scan of the
+// text does, and a truncated or corrupted image must not map at all
+template <class Index>
+void TestImages(const string& type)
+{
+	typedef BasicLinearStore<Index> Store;
+	const string path = "automatontest.sa";
+	mt19937 g(8);
+	bool roundtrip = true;
+	bool rejected = true;
+	for (int k = 0; k < 20; k++)
+	{
+		string s = RandomText(g, k == 0 ? 0 : g() % 400, 1 + k % 4);
+		BasicSuffixAutomaton<Store> sa(s);
+		BasicFrozenSuffixAutomaton<Index> fa(sa);
+		roundtrip = roundtrip && SaveImage(fa, path, s);
+		BasicMappedSuffixAutomaton<Index> mapped;
+		roundtrip = roundtrip && mapped.Open(path) && string_view(mapped.text, mapped.textlen) == s && mapped.size() == fa.size();
+		for (auto& p : SamplePatterns(g, {s}, 100))
+		{
+			vector<int64_t> found = ScanPositions(s, p);
+			Index first = found.empty() ? -1 : found[0];
+			roundtrip = roundtrip && mapped.contains(p) == !found.empty() && mapped.first(p) == first && (size_t)mapped.count(p) == found.size() && Widen(mapped.positions(p)) == found;
+		}
+		mapped.Close();
+		string image = ReadFile(path);
+		Index n = fa.size();
+		Index edges = fa.labels.size();
+		vector<string> bad;
+		for (size_t cut : {(size_t)0, sizeof(ImageHeader) - 1, sizeof(ImageHeader), image.size() / 2, image.size() - 1})
+		{
+			bad.push_back(image.substr(0, cut));
+		}
+		string magic = image;
+		magic[0] = 'X';
+		bad.push_back(magic);
+		// A link out of range, a root with a link, an edge offset past the
+		// edges, and a count too large for the text
+		bad.push_back(Corrupt<Index>(image, 1, n - 1, n));
+		bad.push_back(Corrupt<Index>(image, 1, 0, 0));
+		bad.push_back(Corrupt<Index>(image, 6, n, edges + 1));
+		bad.push_back(Corrupt<Index>(image, 3, 0, n));
+		if (n > 1)
+		{
+			// A child out of range, the root as a child, and a state listed twice
+			bad.push_back(Corrupt<Index>(image, 8, g() % (n - 1), n + 5));
+			bad.push_back(Corrupt<Index>(image, 8, g() % (n - 1), 0));
+			if (n > 2) bad.push_back(Corrupt<Index>(image, 8, 0, fa.children[1]));
+		}
+		if (edges > 0)
+		{
+			bad.push_back(Corrupt<Index>(image, 9, g() % edges, n));
+			bad.push_back(Corrupt<Index>(image, 9, g() % edges, -1));
+		}
+		for (auto& b : bad)
+		{
+			WriteFile(path, b);
+			rejected = rejected && !mapped.Open(path) && mapped.size() == 0;
+		}
+		// An image is only mapped with the index type it was saved with
+		WriteFile(path, image);
+		BasicMappedSuffixAutomaton<typename conditional<sizeof(Index) == 8, int, int64_t>::type> other;
+		rejected = rejected && mapped.Open(path) && !other.Open(path);
+	}
+	remove(path.c_str());
+	Check(roundtrip, "A mapped image with " + type + " indices matches a scan of the text");
+	Check(rejected, "Truncated and corrupted images with " + type + " indices are rejected");
+}
+
+// Each batch must answer every pattern as the view does on its own
+template <bool Counting>
+bool SameAsView(QueryPool& pool, const BasicFrozenView<int, Counting>& batchview, const FrozenView& v, const vector<string>& patterns)
+{
+	vector<char> contains = BatchContains(pool, batchview, patterns);
+	vector<int> first = BatchFirst(pool, batchview, patterns);
+	vector<int> count = BatchCount(pool, batchview, patterns);
+	vector<vector<int>> positions = BatchPositions(pool, batchview, patterns);
+	vector<char> sharedcontains = SharedBatchContains(pool, batchview, patterns);
+	vector<int> sharedfirst = SharedBatchFirst(pool, batchview, patterns);
+	vector<int> sharedcount = SharedBatchCount(pool, batchview, patterns);
+	vector<vector<int>> sharedpositions = SharedBatchPositions(pool, batchview, patterns);
+	bool same = true;
+	for (size_t i = 0; i < patterns.size(); i++)
+	{
+		const string& p = patterns[i];
+		same = same && contains[i] == v.contains(p) && first[i] == v.first(p) && count[i] == v.count(p) && positions[i] == v.positions(p);
+		same = same && sharedcontains[i] == contains[i] && sharedfirst[i] == first[i] && sharedcount[i] == count[i] && sharedpositions[i] == positions[i];
+	}
+	return same;
+}
+
+void TestBatchQueries()
+{
+	mt19937 g(2);
+	string s = RandomText(g, 20000, 3);
+	SuffixAutomaton sa(s);
+	FrozenSuffixAutomaton fa(sa);
+	FrozenView v = fa.View();
+	vector<string> patterns = SamplePatterns(g, {s}, 2000);
+	patterns.push_back("");
+	QueryPool pool(4);
+	Check(SameAsView(pool, v, v, patterns), "Batch and shared-prefix batch queries match single queries");
+	ResetStatistics();
+	bool counted = SameAsView(pool, v.Counted(), v, patterns);
+	// Each of the eight batches records one query per pattern
+	StatisticsSnapshot stats = ReadStatistics();
+	Check(counted && stats.counts[Queries] == 8 * patterns.size(), "Batch queries on a counted view record one query per pattern");
+	// Several request threads share one pool
+	vector<int> expected(patterns.size());
+	for (size_t i = 0; i < patterns.size(); i++)
+	{
+		expected[i] = v.count(patterns[i]);
+	}
+	atomic<bool> same{true};
+	vector<thread> submitters;
+	for (int t = 0; t < 4; t++)
+	{
+		submitters.emplace_back([&]
+		{
+			for (int k = 0; k < 10; k++)
+			{
+				if (BatchCount(pool, v, patterns) != expected || SharedBatchCount(pool, v, patterns) != expected) same = false;
+			}
+		});
+	}
+	for (auto& t : submitters)
+	{
+		t.join();
+	}
+	Check(same, "Batches submitted by four threads at once to one pool are answered correctly");
+	// Position queries on the automaton itself only read, so threads may share it
+	const SuffixAutomaton& shared = sa;
+	atomic<bool> readonly{true};
+	vector<thread> readers;
+	for (int t = 0; t < 4; t++)
+	{
+		readers.emplace_back([&]
+		{
+			for (auto& p : patterns)
+			{
+				if (shared.positions(p) != v.positions(p)) readonly = false;
+			}
+		});
+	}
+	for (auto& t : readers)
+	{
+		t.join();
+	}
+	Check(readonly, "Four threads querying positions of one SuffixAutomaton at once are answered correctly");
+}
+
+int main()
+{
+	mt19937 g(12);
+	Check(FindLabelMatchesScan(g), "FindLabel matches a scan at every length up to 80 labels");
+	Check(ArenaReusesBlocks(), "EdgeArena hands a freed block out again for its own class only");
+	TestStore<LinearStore>("LinearStore");
+	TestStore<SortedStore>("SortedStore");
+	TestStore<MapStore>("MapStore");
+	TestStore<DenseStore>("DenseStore");
+	TestStore<HybridStore<>>("HybridStore");
+	TestStore<AlphabetStore<>>("AlphabetStore");
+	TestStore<HybridStore<uint32_t, 4>>("HybridStore with uint32_t indices");
+	TestStore<AlphabetStore<int64_t, 4>>("AlphabetStore with int64_t indices");
+	TestAlphabetStore();
+	TestShrinkToFit<LinearStore>("LinearStore");
+	TestShrinkToFit<SortedStore>("SortedStore");
+	TestShrinkToFit<MapStore>("MapStore");
+	TestShrinkToFit<DenseStore>("DenseStore");
+	TestShrinkToFit<HybridStore<>>("HybridStore");
+	TestShrinkToFit<AlphabetStore<>>("AlphabetStore");
+	TestCount<int>("int");
+	TestCount<uint32_t>("uint32_t");
+	TestCount<int64_t>("int64_t");
+	TestAppend<int>("int");
+	TestAppend<uint32_t>("uint32_t");
+	TestAppend<int64_t>("int64_t");
+	TestPositionsInOrder<int>("int");
+	TestPositionsInOrder<uint32_t>("uint32_t");
+	TestPositionsInOrder<int64_t>("int64_t");
+	TestGeneralized<int>("int");
+	TestGeneralized<uint32_t>("uint32_t");
+	TestGeneralized<int64_t>("int64_t");
+	TestParallelBuild<int>("int");
+	TestParallelBuild<uint32_t>("uint32_t");
+	TestParallelBuild<int64_t>("int64_t");
+	TestBatchQueries();
+	TestCompactDawg<int>("int");
+	TestCompactDawg<uint32_t>("uint32_t");
+	TestCompactDawg<int64_t>("int64_t");
+	TestApproximateSearch<int>("int");
+	TestApproximateSearch<uint32_t>("uint32_t");
+	TestApproximateSearch<int64_t>("int64_t");
+	TestPositionIndex<int>("int");
+	TestPositionIndex<uint32_t>("uint32_t");
+	TestPositionIndex<int64_t>("int64_t");
+	TestMatchingStatistics<int>("int");
+	TestMatchingStatistics<uint32_t>("uint32_t");
+	TestMatchingStatistics<int64_t>("int64_t");
+	TestSubstringStatistics<int>("int");
+	TestSubstringStatistics<uint32_t>("uint32_t");
+	TestSubstringStatistics<int64_t>("int64_t");
+	TestImages<int>("int");
+	TestImages<uint32_t>("uint32_t");
+	TestImages<int64_t>("int64_t");
+	cout << (failures == 0 ? "All checks passed." : to_string(failures) + " checks failed.") << endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,424 @@
+#ifndef BATCHQUERY_H
+#define BATCHQUERY_H
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <string_view>
+#include <cstdint>
+#include "FrozenSuffixAutomaton.h"
+using namespace std;
+
+// A fixed set of threads that run batches of independent tasks. A batch of
+// count tasks is split evenly into one range per thread. Each thread takes
+// tasks from the front of its own range, and when it runs dry steals the back
+// half of another thread's range. A range is one 64-bit word updated by
+// compare-and-swap, so the only lock is taken once per batch to wake the
+// workers and once to wait for them. A pool runs one batch at a time: any
+// number of threads may submit batches to it, and each waits for the batches
+// ahead of its own. A task must not submit a batch to the pool running it.
+class QueryPool {
+	// Remaining tasks [begin, end) of one thread, on its own cache line
+	struct alignas(64) Range {
+		atomic<uint64_t> r{0};
+	};
+	static uint64_t Pack(uint32_t begin, uint32_t end)
+	{
+		return (uint64_t)end << 32 | begin;
+	}
+	vector<thread> workers;
+	vector<Range> ranges;
+	function<void(int)> job;
+	// Held for a whole batch, so concurrent submitters take turns
+	mutex submit;
+	mutex m;
+	condition_variable wake;
+	condition_variable finished;
+	uint64_t generation = 0;
+	int running = 0;
+	bool stopping = false;
+
+	// Takes the next task from the front of range t, or returns -1
+	int Pop(int t)
+	{
+		uint64_t r = ranges[t].r.load();
+		while (true)
+		{
+			uint32_t begin = r, end = r >> 32;
+			if (begin >= end) return -1;
+			if (ranges[t].r.compare_exchange_weak(r, Pack(begin + 1, end))) return begin;
+		}
+	}
+	// Moves the back half of another thread's range into range t. Returns
+	// false once every other range is empty.
+	bool Steal(int t)
+	{
+		for (int k = 1; k < ranges.size(); k++)
+		{
+			int v = (t + k) % ranges.size();
+			uint64_t r = ranges[v].r.load();
+			while (true)
+			{
+				uint32_t begin = r, end = r >> 32;
+				if (begin >= end) break;
+				uint32_t mid = begin + (end - begin) / 2;
+				if (ranges[v].r.compare_exchange_weak(r, Pack(begin, mid)))
+				{
+					ranges[t].r.store(Pack(mid, end));
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	void Drain(int t)
+	{
+		do
+		{
+			for (int i = Pop(t); i != -1; i = Pop(t))
+			{
+				job(i);
+			}
+		} while (Steal(t));
+	}
+	void Work(int t)
+	{
+		uint64_t seen = 0;
+		while (true)
+		{
+			{
+				unique_lock<mutex> lock(m);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+			}
+			Drain(t);
+			{
+				lock_guard<mutex> lock(m);
+				if (--running == 0) finished.notify_one();
+			}
+		}
+	}
+public:
+	// A pool of the given number of threads, counting the caller, which
+	// works on every batch it submits
+	QueryPool(int threads = thread::hardware_concurrency())
+		: ranges(max(threads, 1))
+	{
+		for (int t = 1; t < ranges.size(); t++)
+		{
+			workers.emplace_back(&QueryPool::Work, this, t);
+		}
+	}
+	QueryPool(const QueryPool&) = delete;
+	QueryPool& operator=(const QueryPool&) = delete;
+	~QueryPool()
+	{
+		{
+			lock_guard<mutex> lock(m);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& w : workers)
+		{
+			w.join();
+		}
+	}
+	int size() const
+	{
+		return ranges.size();
+	}
+	// Runs f(i) for every i in [0, count) and returns once all have finished
+	void ParallelFor(int count, function<void(int)> f)
+	{
+		lock_guard<mutex> turn(submit);
+		int threads = ranges.size();
+		for (int t = 0; t < threads; t++)
+		{
+			ranges[t].r.store(Pack((int64_t)count * t / threads, (int64_t)count * (t + 1) / threads));
+		}
+		job = move(f);
+		{
+			lock_guard<mutex> lock(m);
+			running = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		Drain(0);
+		unique_lock<mutex> lock(m);
+		finished.wait(lock, [&] { return running == 0; });
+	}
+};
+
+// Walks patterns [begin, end) from the root together, calling f(i, state)
+// as pattern i finishes, with state -1 if it fell off the automaton. On an
+// automaton much larger than the cache every step of a single walk waits on a
+// miss that depends on the one before, so instead we keep walklanes patterns
+// in flight and take one step of each in turn. A step has two stages: read the
+// edge range of the state, prefetching its labels and targets, then find the
+// label and prefetch the edge range of the next state. By the time a lane
+// comes round again its data has usually arrived, so the misses of all the
+// lanes overlap. Patterns finish in no particular order.
+const int walklanes = 32;
+
+template <class Index, bool Counting, class Patterns, class F>
+void WalkInterleaved(const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns, int begin, int end, F f)
+{
+	struct Lane {
+		int pattern;
+		int at;
+		Index state;
+		Index edges;
+		int degree;
+		bool ready; // The edge range of state has been read
+	};
+	Lane lanes[walklanes];
+	int active = 0;
+	int nextpattern = begin;
+	// Start the next pattern in lane k, or finish patterns that need no step
+	auto start = [&](int k)
+	{
+		while (nextpattern < end)
+		{
+			int i = nextpattern++;
+			if (patterns[i].size() == 0)
+			{
+				if constexpr (Counting) CountQuery(0);
+				f(i, 0);
+				continue;
+			}
+			lanes[k] = {i, 0, 0, 0, 0, false};
+			return true;
+		}
+		return false;
+	};
+	while (active < walklanes && start(active))
+	{
+		active++;
+	}
+	while (active > 0)
+	{
+		for (int k = 0; k < active; k++)
+		{
+			Lane& l = lanes[k];
+			if (!l.ready)
+			{
+				l.edges = fa.offsets[l.state];
+				l.degree = fa.offsets[l.state + 1] - l.edges;
+				__builtin_prefetch(fa.labels + l.edges);
+				__builtin_prefetch(fa.targets + l.edges);
+				l.ready = true;
+				continue;
+			}
+			const auto& p = patterns[l.pattern];
+			int j = FindLabel(fa.labels + l.edges, l.degree, p[l.at]);
+			Index next = j == -1 ? -1 : fa.targets[l.edges + j];
+			if (next != -1 && ++l.at < p.size())
+			{
+				l.state = next;
+				l.ready = false;
+				__builtin_prefetch(fa.offsets + next);
+				continue;
+			}
+			// at counts the transitions found, including this one
+			if constexpr (Counting) CountQuery(l.at);
+			f(l.pattern, next);
+			// Refill the lane, or move the last lane into it
+			if (!start(k))
+			{
+				lanes[k] = lanes[--active];
+				k--;
+			}
+		}
+	}
+}
+
+// Batch queries over a frozen or mapped automaton of any index type, whose
+// results use that type. FrozenView queries never
+// write, so any number of threads may share one. Patterns are handed out in
+// chunks of grain, and result i is written only by the thread that answered
+// pattern i. Contains results are chars rather than a vector<bool>, whose
+// neighbouring bits could not be written by different threads. Each chunk of
+// contains, first and count queries is walked interleaved. Patterns may
+// be any random-access container of strings or string_views, so a batch of
+// views into a request buffer is answered without copying a pattern. Given a
+// view from Counted(), each pattern records one query and its hops.
+const int batchgrain = 64;
+
+template <class Query>
+void ParallelBatch(QueryPool& pool, int count, Query query)
+{
+	int chunks = (count + batchgrain - 1) / batchgrain;
+	pool.ParallelFor(chunks, [&](int chunk)
+	{
+		int stop = min(count, (chunk + 1) * batchgrain);
+		for (int i = chunk * batchgrain; i < stop; i++)
+		{
+			query(i);
+		}
+	});
+}
+
+// Runs the interleaved walks of each chunk of patterns in parallel
+template <class Index, bool Counting, class Patterns, class F>
+void ParallelWalk(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns, F f)
+{
+	int count = patterns.size();
+	int chunks = (count + batchgrain - 1) / batchgrain;
+	pool.ParallelFor(chunks, [&](int chunk)
+	{
+		WalkInterleaved(fa, patterns, chunk * batchgrain, min(count, (chunk + 1) * batchgrain), f);
+	});
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<char> BatchContains(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<char> r(patterns.size());
+	ParallelWalk(pool, fa, patterns, [&](int i, Index state) { r[i] = state != -1; });
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<Index> BatchFirst(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<Index> r(patterns.size());
+	ParallelWalk(pool, fa, patterns, [&](int i, Index state)
+	{
+		r[i] = state == -1 ? -1 : fa.firstpos[state] - (Index)patterns[i].size() + 1;
+	});
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<Index> BatchCount(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<Index> r(patterns.size());
+	ParallelWalk(pool, fa, patterns, [&](int i, Index state) { r[i] = state == -1 ? 0 : fa.occurrences[state]; });
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<vector<Index>> BatchPositions(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<vector<Index>> r(patterns.size());
+	ParallelBatch(pool, patterns.size(), [&](int i) { r[i] = fa.positions(patterns[i]); });
+	return r;
+}
+
+// Walks patterns order[begin, end) from the root, calling f(i, state) as
+// pattern i finishes, with state -1 if it fell off the automaton. order lists
+// the patterns sorted, so each one shares its longest common prefix with the
+// one before it. path keeps the states along the previous pattern, and a
+// pattern resumes from the state at the end of the prefix they share, so
+// each edge of the trie of the patterns is walked once rather than once per
+// pattern below it.
+template <class Index, bool Counting, class Patterns, class F>
+void WalkSharedPrefixes(const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns, const vector<int>& order, int begin, int end, F f)
+{
+	vector<Index> path = {0};
+	string_view previous;
+	// True if the walk of previous stopped at a missing transition
+	bool failed = false;
+	for (int k = begin; k < end; k++)
+	{
+		int i = order[k];
+		string_view p = patterns[i];
+		int common = 0;
+		int limit = min(p.size(), previous.size());
+		while (common < limit && p[common] == previous[common])
+		{
+			common++;
+		}
+		if (path.size() > common + 1) path.resize(common + 1);
+		// This pattern also contains the character that stopped previous
+		else if (failed && path.size() <= common)
+		{
+			if constexpr (Counting) CountQuery(0);
+			f(i, -1);
+			previous = p;
+			continue;
+		}
+		failed = false;
+		// Only the transitions past the shared prefix are hops of this walk
+		int hops = 0;
+		while (path.size() <= p.size())
+		{
+			Index next = fa.GetTransition(path.back(), p[path.size() - 1]);
+			if (next == -1)
+			{
+				failed = true;
+				break;
+			}
+			path.push_back(next);
+			hops++;
+		}
+		if constexpr (Counting) CountQuery(hops);
+		f(i, failed ? -1 : path.back());
+		previous = p;
+	}
+}
+
+// Runs f(i, state) for every pattern, sorting the patterns and then walking
+// each chunk of the sorted order with shared prefixes in parallel
+template <class Index, bool Counting, class Patterns, class F>
+void ParallelWalkShared(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns, F f)
+{
+	int count = patterns.size();
+	vector<int> order(count);
+	for (int i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [&](int a, int b) { return string_view(patterns[a]) < string_view(patterns[b]); });
+	int chunks = (count + batchgrain - 1) / batchgrain;
+	pool.ParallelFor(chunks, [&](int chunk)
+	{
+		WalkSharedPrefixes(fa, patterns, order, chunk * batchgrain, min(count, (chunk + 1) * batchgrain), f);
+	});
+}
+
+// Batch queries for dictionaries of patterns with long common prefixes, such
+// as URL paths. They give the same results as the batches above.
+template <class Index, bool Counting, class Patterns>
+vector<char> SharedBatchContains(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<char> r(patterns.size());
+	ParallelWalkShared(pool, fa, patterns, [&](int i, Index state) { r[i] = state != -1; });
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<Index> SharedBatchFirst(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<Index> r(patterns.size());
+	ParallelWalkShared(pool, fa, patterns, [&](int i, Index state)
+	{
+		r[i] = state == -1 ? -1 : fa.firstpos[state] - (Index)patterns[i].size() + 1;
+	});
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<Index> SharedBatchCount(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<Index> r(patterns.size());
+	ParallelWalkShared(pool, fa, patterns, [&](int i, Index state) { r[i] = state == -1 ? 0 : fa.occurrences[state]; });
+	return r;
+}
+
+template <class Index, bool Counting, class Patterns>
+vector<vector<Index>> SharedBatchPositions(QueryPool& pool, const BasicFrozenView<Index, Counting>& fa, const Patterns& patterns)
+{
+	vector<vector<Index>> r(patterns.size());
+	ParallelWalkShared(pool, fa, patterns, [&](int i, Index state)
+	{
+		if (state != -1) r[i] = fa.PositionsFrom(state, patterns[i].size());
+	});
+	return r;
+}
+#endif
@@ -0,0 +1,314 @@
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "FrozenSuffixAutomaton.h"
+#include "CompactDawg.h"
+using namespace std;
+using namespace chrono;
+
+// Benchmarks every transition store on a set of corpora and writes one CSV row
+// per (corpus, store, operation) to stdout:
+//   corpus,store,operation,chars,states,repetitions,samples,throughput,unit,
+//   p50_ns,p99_ns,peak_rss_kb,bytes_per_char
+// Build rows time whole constructions, so throughput is in chars/s and the
+// percentiles are over repetitions. Query rows time every query, so
+// throughput is in queries/s and the percentiles are per query. bytes_per_char
+// is the resident memory added by one build. Each (corpus, store) pair runs in
+// its own process, so peak_rss_kb is that pair's own high water mark. The
+// alphabet store learns the alphabet as it builds, and the large store is the
+// linear store with 64-bit indices. The cdawg rows compact a linear store
+// automaton into a CompactDawg, whose states column counts its nodes.
+//
+// Usage: Benchmark [-n chars] [-r repetitions] [-q queries] [corpus...]
+// A corpus is random, moststates or mosttransitions, generated with n chars,
+// or the path of a text file. A .in file of test lines uses its longest line.
+struct Options {
+	int n = 1000000;
+	int repetitions = 5;
+	int queries = 10000;
+};
+
+// DenseStore takes 1 KB per state, so it only runs on small corpora
+const int denselimit = 1 << 18;
+
+string CorpusName(const string& corpus)
+{
+	size_t slash = corpus.find_last_of('/');
+	string name = slash == string::npos ? corpus : corpus.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	return dot == string::npos ? name : name.substr(0, dot);
+}
+
+bool LoadCorpus(const string& corpus, const Options& o, string& text)
+{
+	if (corpus == "random")
+	{
+		mt19937 g(1);
+		string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+		text.resize(o.n);
+		for (auto& c : text)
+		{
+			c = letters[g() % letters.size()];
+		}
+		return true;
+	}
+	// The strings of Input Generators/moststates.py and mosttransitions.py
+	if (corpus == "moststates" || corpus == "mosttransitions")
+	{
+		text = "a" + string(o.n, 'b');
+		if (corpus == "mosttransitions") text += "c";
+		return true;
+	}
+	ifstream file(corpus, ios::binary);
+	if (!file.is_open()) return false;
+	if (corpus.size() > 3 && corpus.compare(corpus.size() - 3, 3, ".in") == 0)
+	{
+		string line;
+		while (getline(file, line))
+		{
+			if (line.size() > text.size()) text = line;
+		}
+		return true;
+	}
+	stringstream ss;
+	ss << file.rdbuf();
+	text = ss.str();
+	return true;
+}
+
+// Resident set size in bytes
+long long ResidentBytes()
+{
+	long long pages = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f)
+	{
+		if (fscanf(f, "%lld %lld", &pages, &resident) != 2) resident = 0;
+		fclose(f);
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+long long PeakResidentKB()
+{
+	struct rusage r;
+	getrusage(RUSAGE_SELF, &r);
+	return r.ru_maxrss;
+}
+
+long long Percentile(vector<long long> t, double p)
+{
+	if (t.empty()) return 0;
+	size_t k = min(t.size() - 1, (size_t)(p * t.size()));
+	nth_element(t.begin(), t.begin() + k, t.end());
+	return t[k];
+}
+
+struct Row {
+	string operation;
+	int repetitions;
+	vector<long long> times;
+	double throughput;
+	string unit;
+};
+
+// Substrings of the text of 4 to 16 chars, a quarter of them changed to miss
+vector<string> Patterns(const string& text, int count)
+{
+	mt19937 g(2);
+	vector<string> p(count);
+	if (text.empty()) return p;
+	for (auto& s : p)
+	{
+		int len = min<int>(text.size(), 4 + g() % 13);
+		s = text.substr(g() % (text.size() - len + 1), len);
+		if (g() % 4 == 0) s[g() % len] = '\x01';
+	}
+	return p;
+}
+
+// Times query(pattern) on every pattern, after one untimed warm-up pass
+template <class Query>
+Row TimeQueries(const string& operation, const vector<string>& patterns, const Options& o, Query query)
+{
+	Row r{operation, o.repetitions, {}, 0, "queries/s"};
+	long long sink = 0;
+	for (auto& p : patterns)
+	{
+		sink += query(p);
+	}
+	long long total = 0;
+	for (int k = 0; k < o.repetitions; k++)
+	{
+		for (auto& p : patterns)
+		{
+			auto start = steady_clock::now();
+			long long x = query(p);
+			// Keep the query from being moved past the clock read
+			asm volatile("" : : "g"(x) : "memory");
+			sink += x;
+			long long t = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+			r.times.push_back(t);
+			total += t;
+		}
+	}
+	r.throughput = total > 0 ? r.times.size() * 1e9 / total : 0;
+	if (sink == -1) cerr << sink;
+	return r;
+}
+
+template <class Automaton>
+vector<Row> TimeAllQueries(Automaton& a, const string& text, const Options& o)
+{
+	vector<string> patterns = Patterns(text, o.queries);
+	// Patterns of repetitive corpora can occur at almost every position
+	vector<string> few(patterns.begin(), patterns.begin() + max(1, o.queries / 100));
+	vector<Row> rows;
+	rows.push_back(TimeQueries("contains", patterns, o, [&](const string& p) { return (long long)a.contains(p); }));
+	rows.push_back(TimeQueries("first", patterns, o, [&](const string& p) { return (long long)a.first(p); }));
+	rows.push_back(TimeQueries("count", patterns, o, [&](const string& p) { return (long long)a.count(p); }));
+	rows.push_back(TimeQueries("positions", few, o, [&](const string& p) { return (long long)a.positions(p).size(); }));
+	return rows;
+}
+
+void PrintRows(const string& corpus, const string& store, const string& text, long long states, double bytesperchar, const vector<Row>& rows)
+{
+	long long peak = PeakResidentKB();
+	for (auto& r : rows)
+	{
+		cout << corpus << "," << store << "," << r.operation << "," << text.size() << "," << states << "," << r.repetitions << "," << r.times.size() << "," << r.throughput << "," << r.unit << "," << Percentile(r.times, 0.5) << "," << Percentile(r.times, 0.99) << "," << peak << "," << bytesperchar << endl;
+	}
+}
+
+// Builds text once untimed to measure its memory, then repetitions more times
+template <class Store>
+void RunStore(const string& corpus, const string& store, const string& text, const Options& o)
+{
+	Row build{"build", o.repetitions, {}, 0, "chars/s"};
+	long long before = ResidentBytes();
+	auto sa = make_unique<BasicSuffixAutomaton<Store>>(text);
+	double bytesperchar = text.empty() ? 0 : (ResidentBytes() - before) / (double)text.size();
+	long long total = 0;
+	for (int k = 0; k < o.repetitions; k++)
+	{
+		sa.reset();
+		auto start = steady_clock::now();
+		sa = make_unique<BasicSuffixAutomaton<Store>>(text);
+		long long t = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+		build.times.push_back(t);
+		total += t;
+	}
+	build.throughput = total > 0 ? text.size() * (double)o.repetitions * 1e9 / total : 0;
+	vector<Row> rows = {build};
+	for (auto& r : TimeAllQueries(*sa, text, o))
+	{
+		rows.push_back(r);
+	}
+	PrintRows(corpus, store, text, sa->size(), bytesperchar, rows);
+}
+
+// Builds with LinearStore and packs the automaton with pack(sa); the build
+// row times both steps
+template <class Pack>
+void RunPacked(const string& corpus, const string& store, const string& text, const Options& o, Pack pack)
+{
+	Row build{"build", o.repetitions, {}, 0, "chars/s"};
+	long long before = ResidentBytes();
+	auto fa = pack(SuffixAutomaton(text));
+	double bytesperchar = text.empty() ? 0 : (ResidentBytes() - before) / (double)text.size();
+	long long total = 0;
+	for (int k = 0; k < o.repetitions; k++)
+	{
+		fa.reset();
+		auto start = steady_clock::now();
+		fa = pack(SuffixAutomaton(text));
+		long long t = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+		build.times.push_back(t);
+		total += t;
+	}
+	build.throughput = total > 0 ? text.size() * (double)o.repetitions * 1e9 / total : 0;
+	vector<Row> rows = {build};
+	for (auto& r : TimeAllQueries(*fa, text, o))
+	{
+		rows.push_back(r);
+	}
+	PrintRows(corpus, store, text, fa->size(), bytesperchar, rows);
+}
+
+void Run(const string& corpus, const string& store, const Options& o)
+{
+	string text;
+	if (!LoadCorpus(corpus, o, text))
+	{
+		cerr << "Could not read " << corpus << endl;
+		return;
+	}
+	string name = CorpusName(corpus);
+	if (store == "linear") RunStore<LinearStore>(name, store, text, o);
+	else if (store == "sorted") RunStore<SortedStore>(name, store, text, o);
+	else if (store == "map") RunStore<MapStore>(name, store, text, o);
+	else if (store == "hybrid") RunStore<HybridStore<>>(name, store, text, o);
+	else if (store == "alphabet") RunStore<AlphabetStore<>>(name, store, text, o);
+	else if (store == "large") RunStore<BasicLinearStore<int64_t>>(name, store, text, o);
+	else if (store == "dense")
+	{
+		if (text.size() <= denselimit) RunStore<DenseStore>(name, store, text, o);
+		else cerr << "Skipping dense on " << name << ", which has more than " << denselimit << " chars" << endl;
+	}
+	else if (store == "cdawg") RunPacked(name, store, text, o, [&](const SuffixAutomaton& sa) { return make_unique<CompactDawg>(sa, text); });
+	else RunPacked(name, store, text, o, [](const SuffixAutomaton& sa) { return make_unique<FrozenSuffixAutomaton>(sa); });
+}
+
+int main(int argc, char** argv)
+{
+	Options o;
+	vector<string> corpora;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc) o.n = atoi(argv[++i]);
+		else if (arg == "-r" && i + 1 < argc) o.repetitions = max(1, atoi(argv[++i]));
+		else if (arg == "-q" && i + 1 < argc) o.queries = max(1, atoi(argv[++i]));
+		else corpora.push_back(arg);
+	}
+	if (corpora.empty())
+	{
+		corpora = {"random", "moststates", "mosttransitions", "Input Generators/anna.txt", "Input Generators/iron.txt", "Input Generators/freud.txt"};
+		// The Bible is not distributed with the repository
+		if (access("bible.txt", R_OK) == 0) corpora.push_back("bible.txt");
+	}
+	vector<string> stores = {"linear", "sorted", "map", "dense", "hybrid", "alphabet", "large", "frozen", "cdawg"};
+	cout << "corpus,store,operation,chars,states,repetitions,samples,throughput,unit,p50_ns,p99_ns,peak_rss_kb,bytes_per_char" << endl;
+	for (auto& corpus : corpora)
+	{
+		for (auto& store : stores)
+		{
+			cerr << "Benchmarking " << store << " on " << corpus << "..." << endl;
+			// A child process per pair keeps the peak RSS of each separate
+			cout.flush();
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				Run(corpus, store, o);
+				cout.flush();
+				_exit(0);
+			}
+			int status = 0;
+			if (pid == -1 || waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			{
+				cerr << "Benchmark of " << store << " on " << corpus << " failed" << endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,247 @@
+#ifndef COMPACTDAWG_H
+#define COMPACTDAWG_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include "SuffixAutomaton.h"
+using namespace std;
+
+// A compact DAWG (CDAWG) of a finished SuffixAutomaton: every chain of states
+// with a single out-edge is folded into the edge that enters it, so only the
+// root and the states with no edge or several edges remain as nodes. An edge
+// is labelled by the characters of its chain, kept as the slice
+// text[starts[e], starts[e] + lengths[e]) of the source text rather than
+// copied, and a walk compares each label against the pattern with memcmp.
+// Repetitive text has long chains, so it keeps a small fraction of the
+// automaton's states and its walks take one hop per edge instead of one per
+// character.
+//
+// A string that ends rest characters into an edge of node w occurs at the
+// end positions of w less rest. The only other occurrences are those cut off
+// by the end of the text: one for each terminal state folded into the edge
+// at most rest characters before w. Those are kept per edge as their
+// distance to w, in increasing order, in stops[stopoffsets[e]] to
+// stops[stopoffsets[e+1]-1]. The end positions of w are the slice
+// [in[w], in[w] + occurrences[w]) of ends, the end positions of the
+// automaton's non-clone states in link tree preorder, as in PositionIndex.
+//
+// Out-edges are laid out as in FrozenView, sorted by first character. The
+// automaton must be of a single text, and text must stay alive and
+// unchanged while the DAWG is used.
+template <class I = int>
+struct BasicCompactDawg {
+	typedef I Index;
+	string_view text;
+	vector<Index> firstpos;
+	vector<Index> occurrences;
+	vector<Index> in;
+	vector<Index> offsets;
+	vector<char> labels;
+	vector<Index> targets;
+	vector<Index> starts;
+	vector<Index> lengths;
+	vector<Index> stopoffsets;
+	vector<Index> stops;
+	vector<Index> ends;
+
+	// Compacts sa, which must have been built from s
+	template <class Store, bool Counting>
+	BasicCompactDawg(const BasicSuffixAutomaton<Store, Counting>& sa, string_view s) : text(s)
+	{
+		static_assert(is_same<typename Store::IndexType, Index>::value, "Compact an automaton with the index type it was built with");
+		Index n = sa.size();
+		vector<bool> terminal(n, false);
+		sa.ForEachTerminal([&](Index i) { terminal[i] = true; });
+		vector<Index> node(n, -1);
+		Index nodes = 0;
+		for (Index i = 0; i < n; i++)
+		{
+			if (i == 0 || sa.transitions.Degree(i) != 1) node[i] = nodes++;
+		}
+		// For each state, the node its chain leads to, the characters left to
+		// it, and the first terminal state folded on the way. An edge always
+		// leads to a longer state, so in decreasing order of len the rest of
+		// every chain is known before the state in front of it.
+		vector<Index> order = OrderByLen(sa.len);
+		vector<Index> next(n, -1);
+		vector<Index> reach(n);
+		vector<Index> rest(n, 0);
+		vector<Index> nextstop(n, -1);
+		for (Index k = n; k > 0; k--)
+		{
+			Index i = order[k - 1];
+			reach[i] = i;
+			if (node[i] != -1) continue;
+			sa.transitions.ForEach(i, [&](char, Index t) { next[i] = t; });
+			reach[i] = reach[next[i]];
+			rest[i] = rest[next[i]] + 1;
+			nextstop[i] = terminal[i] ? i : nextstop[next[i]];
+		}
+		// Lay out the end positions in link tree preorder. In increasing order
+		// of len each state takes the next slice of its parent's.
+		vector<Index> counts = CountOccurrences(sa.len, sa.link, sa.clone);
+		vector<Index> slice(n, 0);
+		vector<Index> fill(n, 0);
+		ends.resize(counts[0]);
+		for (Index k = 1; k < n; k++)
+		{
+			Index i = order[k];
+			slice[i] = fill[sa.link[i]];
+			fill[sa.link[i]] += counts[i];
+			fill[i] = slice[i];
+			if (!sa.clone[i]) ends[fill[i]++] = sa.firstpos[i];
+		}
+		firstpos.resize(nodes);
+		occurrences.resize(nodes);
+		in.resize(nodes);
+		offsets.resize(nodes + 1);
+		stopoffsets = {0};
+		vector<pair<unsigned char, Index>> edges;
+		for (Index i = 0; i < n; i++)
+		{
+			if (node[i] == -1) continue;
+			Index u = node[i];
+			firstpos[u] = sa.firstpos[i];
+			occurrences[u] = counts[i];
+			in[u] = slice[i];
+			offsets[u] = labels.size();
+			edges.clear();
+			sa.transitions.ForEach(i, [&](char c, Index t) { edges.push_back({c, t}); });
+			sort(edges.begin(), edges.end());
+			for (auto& [c, t] : edges)
+			{
+				Index w = reach[t];
+				Index length = rest[t] + 1;
+				labels.push_back(c);
+				targets.push_back(node[w]);
+				// Every string of w ends with the label, so its first occurrence does
+				starts.push_back(sa.firstpos[w] - length + 1);
+				lengths.push_back(length);
+				size_t from = stops.size();
+				for (Index x = nextstop[t]; x != -1; x = nextstop[next[x]])
+				{
+					stops.push_back(rest[x]);
+				}
+				reverse(stops.begin() + from, stops.end());
+				stopoffsets.push_back(stops.size());
+			}
+		}
+		offsets[nodes] = labels.size();
+	}
+	Index size() const
+	{
+		return firstpos.size();
+	}
+	// Returns the bytes held by each component. The text is only viewed, so
+	// it is not counted.
+	MemoryReport Memory() const
+	{
+		MemoryReport r;
+		r.states = VectorMemory(firstpos);
+		r.transitions = VectorMemory(offsets);
+		r.transitions += VectorMemory(labels);
+		r.transitions += VectorMemory(targets);
+		r.transitions += VectorMemory(starts);
+		r.transitions += VectorMemory(lengths);
+		r.transitions += VectorMemory(stopoffsets);
+		r.transitions += VectorMemory(stops);
+		r.linktree = VectorMemory(in);
+		r.linktree += VectorMemory(ends);
+		r.occurrences = VectorMemory(occurrences);
+		return r;
+	}
+	// Follows s from the root. Returns the node at or after the end of s, or
+	// -1 if s does not occur, and sets edge to the last edge taken (-1 for an
+	// empty s) and rest to the characters of it left unread.
+	Index Walk(string_view s, Index& edge, Index& rest) const
+	{
+		Index i = 0;
+		edge = -1;
+		rest = 0;
+		size_t at = 0;
+		while (at < s.size())
+		{
+			int j = FindLabel(labels.data() + offsets[i], offsets[i + 1] - offsets[i], s[at]);
+			if (j == -1) return -1;
+			edge = offsets[i] + j;
+			size_t m = min<size_t>(lengths[edge], s.size() - at);
+			if (memcmp(text.data() + starts[edge], s.data() + at, m) != 0) return -1;
+			at += m;
+			rest = lengths[edge] - m;
+			i = targets[edge];
+		}
+		return i;
+	}
+	// The stops of edge within rest characters of its node
+	Index StopsWithin(Index edge, Index rest) const
+	{
+		if (edge == -1) return 0;
+		return upper_bound(stops.begin() + stopoffsets[edge], stops.begin() + stopoffsets[edge + 1], rest) - (stops.begin() + stopoffsets[edge]);
+	}
+	// O(s) query to see if our source text contains a substring s
+	bool contains(string_view s) const
+	{
+		Index edge, rest;
+		return Walk(s, edge, rest) != -1;
+	}
+	// Returns the position of the first occurrence of a non-empty string s,
+	// or -1 if it does not occur. Occurrences cut off by the end of the text
+	// come after every other.
+	Index first(string_view s) const
+	{
+		Index edge, rest;
+		Index i = Walk(s, edge, rest);
+		if (i == -1) return -1;
+		return firstpos[i] - rest - s.size() + 1;
+	}
+	// Returns the number of occurrences of a non-empty string s in O(s)
+	Index count(string_view s) const
+	{
+		Index edge, rest;
+		Index i = Walk(s, edge, rest);
+		if (i == -1) return 0;
+		return occurrences[i] + StopsWithin(edge, rest);
+	}
+	// Return a vector of positions where a non-empty string s occurs
+	vector<Index> positions(string_view s) const
+	{
+		vector<Index> p;
+		ForEachPosition(s, [&](Index i)
+		{
+			p.push_back(i);
+			return true;
+		});
+		sort(p.begin(), p.end());
+		return p;
+	}
+	// Calls f(i) for every position i where a non-empty string s occurs, in
+	// no particular order, until f returns false
+	template <class F>
+	void ForEachPosition(string_view s, F f) const
+	{
+		Index edge, rest;
+		Index i = Walk(s, edge, rest);
+		if (i == -1) return;
+		Index sz = s.size();
+		for (Index k = in[i]; k < in[i] + occurrences[i]; k++)
+		{
+			if (!f(ends[k] - rest - sz + 1)) return;
+		}
+		Index n = text.size();
+		Index within = StopsWithin(edge, rest);
+		for (Index k = 0; k < within; k++)
+		{
+			if (!f(n - sz - rest + stops[stopoffsets[edge] + k])) return;
+		}
+	}
+};
+
+// Lets BasicCompactDawg dawg(sa, s) take the index type of sa
+template <class Store, bool Counting>
+BasicCompactDawg(const BasicSuffixAutomaton<Store, Counting>&, string_view) -> BasicCompactDawg<typename Store::IndexType>;
+
+typedef BasicCompactDawg<> CompactDawg;
+#endif
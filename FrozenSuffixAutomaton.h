@@ -0,0 +1,327 @@
+#ifndef FROZENSUFFIXAUTOMATON_H
+#define FROZENSUFFIXAUTOMATON_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include "SuffixAutomaton.h"
+using namespace std;
+
+// Read-only access to a packed automaton through plain pointers. The out-edges
+// of state i are labels[offsets[i]] to labels[offsets[i+1]-1], in increasing
+// order of label as an unsigned char, with the matching targets at the same
+// indices. The children of i in the link tree are
+// children[childoffsets[i]] to children[childoffsets[i+1]-1]. Clone and
+// terminal flags are bitsets of 64-bit words. The arrays belong to a
+// FrozenSuffixAutomaton or to a mapped image file, and queries never write.
+// Every index is of the automaton's Index type. With Counting set, queries
+// record the events listed in Statistics.h, as those of a SuffixAutomaton
+// built with the flag do; Counted() gives such a copy of any view.
+template <class I = int, bool Counting = false>
+struct BasicFrozenView {
+	typedef I Index;
+	Index n = 0;
+	Index edges = 0;
+	const Index* len = nullptr;
+	const Index* link = nullptr;
+	const Index* firstpos = nullptr;
+	const Index* occurrences = nullptr;
+	const uint64_t* clonebits = nullptr;
+	const uint64_t* terminalbits = nullptr;
+	const Index* offsets = nullptr;
+	const char* labels = nullptr;
+	const Index* targets = nullptr;
+	const Index* childoffsets = nullptr;
+	const Index* children = nullptr;
+
+	static size_t Words(size_t n)
+	{
+		return (n + 63) / 64;
+	}
+	BasicFrozenView<Index, true> Counted() const
+	{
+		BasicFrozenView<Index, true> v;
+		v.n = n;
+		v.edges = edges;
+		v.len = len;
+		v.link = link;
+		v.firstpos = firstpos;
+		v.occurrences = occurrences;
+		v.clonebits = clonebits;
+		v.terminalbits = terminalbits;
+		v.offsets = offsets;
+		v.labels = labels;
+		v.targets = targets;
+		v.childoffsets = childoffsets;
+		v.children = children;
+		return v;
+	}
+	bool IsClone(Index i) const
+	{
+		return clonebits[i >> 6] >> (i & 63) & 1;
+	}
+	bool IsTerminal(Index i) const
+	{
+		return terminalbits[i >> 6] >> (i & 63) & 1;
+	}
+	// Returns the index of a state or -1 if no transition exists for c
+	Index GetTransition(Index i, char c) const
+	{
+		int j = FindLabel(labels + offsets[i], offsets[i + 1] - offsets[i], c);
+		return j == -1 ? -1 : targets[offsets[i] + j];
+	}
+	// Returns the state reached by s, or -1
+	Index Walk(string_view s) const
+	{
+		Index next = 0;
+		int hops = 0;
+		for (auto& c : s)
+		{
+			next = GetTransition(next, c);
+			if (next == -1) break;
+			hops++;
+		}
+		if constexpr (Counting) CountQuery(hops);
+		return next;
+	}
+	// O(s) query to see if our source text contains a substring s
+	bool contains(string_view s) const
+	{
+		return Walk(s) != -1;
+	}
+	// Returns the position of the first occurrence of a non-empty string s,
+	// or -1 if it does not occur
+	Index first(string_view s) const
+	{
+		Index next = Walk(s);
+		if (next == -1) return -1;
+		return firstpos[next] - s.size() + 1;
+	}
+	// Returns the number of occurrences of a non-empty string s in O(s)
+	Index count(string_view s) const
+	{
+		Index next = Walk(s);
+		return next == -1 ? 0 : occurrences[next];
+	}
+	// Return a vector of positions where a non-empty string s occurs
+	vector<Index> positions(string_view s) const
+	{
+		Index next = Walk(s);
+		return next == -1 ? vector<Index>() : PositionsFrom(next, s.size());
+	}
+	// Sorted positions of the strings of length sz that reach state next
+	vector<Index> PositionsFrom(Index next, Index sz) const
+	{
+		vector<Index> p;
+		ForEachPositionFrom(next, sz, [&](Index i)
+		{
+			p.push_back(i);
+			return true;
+		});
+		sort(p.begin(), p.end());
+		return p;
+	}
+	// Calls f(i) for every position i where a non-empty string s occurs, in
+	// no particular order, until f returns false
+	template <class F>
+	void ForEachPosition(string_view s, F f) const
+	{
+		Index next = Walk(s);
+		if (next != -1) ForEachPositionFrom(next, s.size(), f);
+	}
+	// As ForEachPosition, for the strings of length sz that reach state next
+	template <class F>
+	void ForEachPositionFrom(Index next, Index sz, F f) const
+	{
+		// Traverse link tree down from first occurrence to find all others
+		VisitLinkSubtree(next, [&](Index i) { return (int)(childoffsets[i + 1] - childoffsets[i]); }, [&](Index i, int j) { return children[childoffsets[i] + j]; }, [&](Index i)
+		{
+			if constexpr (Counting) CountEvent(PositionVisits);
+			return IsClone(i) || f(firstpos[i] - sz + 1);
+		});
+	}
+	// As ForEachPosition, but in increasing order of position
+	template <class F>
+	void ForEachPositionInOrder(string_view s, F f) const
+	{
+		Index sz = s.size();
+		Index next = Walk(s);
+		if (next == -1) return;
+		VisitEndsInOrder(next, firstpos, [&](Index i) { return (int)(childoffsets[i + 1] - childoffsets[i]); }, [&](Index i, int j) { return children[childoffsets[i] + j]; }, [&](Index i) { return IsClone(i); }, [&](Index end)
+		{
+			return f(end - sz + 1);
+		});
+	}
+	// Returns the first k positions of a non-empty string s in the text
+	vector<Index> FirstPositions(string_view s, size_t k) const
+	{
+		vector<Index> p;
+		if (k == 0) return p;
+		ForEachPositionInOrder(s, [&](Index i)
+		{
+			p.push_back(i);
+			return p.size() < k;
+		});
+		return p;
+	}
+};
+typedef BasicFrozenView<> FrozenView;
+
+// An immutable copy of a finished SuffixAutomaton with every transition packed
+// into contiguous arrays, laid out as described for FrozenView. The link tree
+// is packed the same way, so a query walk never leaves these few allocations.
+// It keeps the index type of the automaton it was built from.
+template <class I = int>
+struct BasicFrozenSuffixAutomaton {
+	typedef I Index;
+	typedef BasicFrozenView<Index> ViewType;
+	vector<Index> len;
+	vector<Index> link;
+	vector<Index> firstpos;
+	vector<Index> occurrences;
+	vector<uint64_t> clonebits;
+	vector<uint64_t> terminalbits;
+	vector<Index> offsets;
+	vector<char> labels;
+	vector<Index> targets;
+	vector<Index> childoffsets;
+	vector<Index> children;
+
+	template <class Store, bool Counting>
+	BasicFrozenSuffixAutomaton(const BasicSuffixAutomaton<Store, Counting>& sa)
+	{
+		static_assert(is_same<typename Store::IndexType, Index>::value, "Freeze an automaton with the index type it was built with");
+		Index n = sa.size();
+		len.resize(n);
+		link.resize(n);
+		firstpos.resize(n);
+		clonebits.assign(ViewType::Words(n), 0);
+		terminalbits.assign(ViewType::Words(n), 0);
+		offsets.resize(n + 1);
+		childoffsets.assign(n + 1, 0);
+		size_t total = 0;
+		for (Index i = 0; i < n; i++)
+		{
+			total += sa.transitions.Degree(i);
+		}
+		labels.reserve(total);
+		targets.reserve(total);
+		vector<pair<unsigned char, Index>> edges;
+		for (Index i = 0; i < n; i++)
+		{
+			len[i] = sa.len[i];
+			link[i] = sa.link[i];
+			firstpos[i] = sa.firstpos[i];
+			if (sa.clone[i]) clonebits[i >> 6] |= (uint64_t)1 << (i & 63);
+			offsets[i] = labels.size();
+			// Sort each state's edges so lexicographic walks can read them in order
+			edges.clear();
+			sa.transitions.ForEach(i, [&](char c, Index t) { edges.push_back({c, t}); });
+			sort(edges.begin(), edges.end());
+			for (auto& [c, t] : edges)
+			{
+				labels.push_back(c);
+				targets.push_back(t);
+			}
+			if (i > 0) childoffsets[link[i] + 1]++;
+		}
+		offsets[n] = labels.size();
+		occurrences = CountOccurrences(sa.len, sa.link, sa.clone);
+		sa.ForEachTerminal([&](Index i) { terminalbits[i >> 6] |= (uint64_t)1 << (i & 63); });
+		// Counting sort of the states by their link to lay out the link tree
+		for (Index i = 0; i < n; i++)
+		{
+			childoffsets[i + 1] += childoffsets[i];
+		}
+		children.resize(n > 0 ? n - 1 : 0);
+		vector<Index> fill(childoffsets.begin(), childoffsets.end() - 1);
+		for (Index i = 1; i < n; i++)
+		{
+			children[fill[link[i]]++] = i;
+		}
+	}
+	Index size() const
+	{
+		return len.size();
+	}
+	// Returns the bytes held by each component. Every array is sized exactly
+	// when frozen, so there is no slack to reclaim.
+	MemoryReport Memory() const
+	{
+		MemoryReport r;
+		r.states = VectorMemory(len);
+		r.states += VectorMemory(link);
+		r.states += VectorMemory(firstpos);
+		r.states += VectorMemory(clonebits);
+		r.states += VectorMemory(terminalbits);
+		r.transitions = VectorMemory(offsets);
+		r.transitions += VectorMemory(labels);
+		r.transitions += VectorMemory(targets);
+		r.linktree = VectorMemory(childoffsets);
+		r.linktree += VectorMemory(children);
+		r.occurrences = VectorMemory(occurrences);
+		return r;
+	}
+	// Returns pointers to this automaton's arrays, valid until it is destroyed
+	ViewType View() const
+	{
+		ViewType v;
+		v.n = len.size();
+		v.edges = labels.size();
+		v.len = len.data();
+		v.link = link.data();
+		v.firstpos = firstpos.data();
+		v.occurrences = occurrences.data();
+		v.clonebits = clonebits.data();
+		v.terminalbits = terminalbits.data();
+		v.offsets = offsets.data();
+		v.labels = labels.data();
+		v.targets = targets.data();
+		v.childoffsets = childoffsets.data();
+		v.children = children.data();
+		return v;
+	}
+	Index GetTransition(Index i, char c) const
+	{
+		return View().GetTransition(i, c);
+	}
+	bool contains(string_view s) const
+	{
+		return View().contains(s);
+	}
+	Index first(string_view s) const
+	{
+		return View().first(s);
+	}
+	Index count(string_view s) const
+	{
+		return View().count(s);
+	}
+	vector<Index> positions(string_view s) const
+	{
+		return View().positions(s);
+	}
+	template <class F>
+	void ForEachPosition(string_view s, F f) const
+	{
+		View().ForEachPosition(s, f);
+	}
+	template <class F>
+	void ForEachPositionInOrder(string_view s, F f) const
+	{
+		View().ForEachPositionInOrder(s, f);
+	}
+	vector<Index> FirstPositions(string_view s, size_t k) const
+	{
+		return View().FirstPositions(s, k);
+	}
+};
+
+// Lets BasicFrozenSuffixAutomaton fa(sa) take the index type of sa
+template <class Store, bool Counting>
+BasicFrozenSuffixAutomaton(const BasicSuffixAutomaton<Store, Counting>&) -> BasicFrozenSuffixAutomaton<typename Store::IndexType>;
+
+typedef BasicFrozenSuffixAutomaton<> FrozenSuffixAutomaton;
+#endif
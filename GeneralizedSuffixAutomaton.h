@@ -0,0 +1,199 @@
+#ifndef GENERALIZEDSUFFIXAUTOMATON_H
+#define GENERALIZEDSUFFIXAUTOMATON_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include "SuffixAutomaton.h"
+using namespace std;
+
+// One suffix automaton over many documents, sharing the states of every
+// substring the documents have in common. Positions are reported as
+// (document id, offset) pairs, and each state knows how many distinct
+// documents contain its strings.
+//
+// A state of a generalized automaton can be reached by prefixes of several
+// documents, so the clone flag no longer tells us where occurrences end.
+// Instead we record the state reached after every prefix of every document:
+// the occurrences of a string are the prefix ends found in the link subtree
+// of its state.
+template <class Store>
+struct BasicGeneralizedSuffixAutomaton {
+	typedef typename Store::IndexType IndexType;
+	BasicSuffixAutomaton<Store> sa;
+	// The state after each prefix of each document, all documents in order.
+	// Prefix g of the corpus ends at offset g - documentstart[d] of document d.
+	vector<IndexType> endstate;
+	vector<IndexType> documentstart;
+	// Per state, computed by Index(): the prefix ends in its link subtree are
+	// ends[slicestart[i]] to ends[sliceend[i]-1], and documentfrequency[i] is
+	// the number of documents among them
+	bool indexed = false;
+	vector<IndexType> ends;
+	vector<IndexType> slicestart;
+	vector<IndexType> sliceend;
+	vector<int> documentfrequency;
+
+	BasicGeneralizedSuffixAutomaton() {}
+	BasicGeneralizedSuffixAutomaton(const vector<string>& documents)
+	{
+		for (auto& d : documents)
+		{
+			AddDocument(d);
+		}
+	}
+	// Adds document d and returns its id, or -1 if the corpus would no longer
+	// fit the index type
+	int AddDocument(string_view d)
+	{
+		if (!sa.Fits(d.size()))
+		{
+			sa.overflowed = true;
+			return -1;
+		}
+		documentstart.push_back(endstate.size());
+		sa.StartDocument();
+		for (auto& c : d)
+		{
+			sa.extend(c);
+			endstate.push_back(sa.last);
+		}
+		indexed = false;
+		return documentstart.size() - 1;
+	}
+	int documents() const
+	{
+		return documentstart.size();
+	}
+	// Returns the document containing prefix end g
+	int DocumentOf(IndexType g) const
+	{
+		return upper_bound(documentstart.begin(), documentstart.end(), g) - documentstart.begin() - 1;
+	}
+	// Lay out the prefix ends by a DFS of the link tree, so the ends below
+	// every state form one contiguous slice, and count the documents in each
+	void Index()
+	{
+		IndexType n = sa.size();
+		// Bucket the prefix ends by the state they stop at
+		vector<IndexType> bucketoffsets(n + 1, 0);
+		for (auto& i : endstate)
+		{
+			bucketoffsets[i + 1]++;
+		}
+		for (IndexType i = 0; i < n; i++)
+		{
+			bucketoffsets[i + 1] += bucketoffsets[i];
+		}
+		vector<IndexType> buckets(endstate.size());
+		vector<IndexType> fill(bucketoffsets.begin(), bucketoffsets.end() - 1);
+		for (IndexType g = 0; g < endstate.size(); g++)
+		{
+			buckets[fill[endstate[g]]++] = g;
+		}
+		// Preorder DFS: each state's own ends, then its subtrees in turn
+		slicestart.assign(n, 0);
+		sliceend.assign(n, 0);
+		ends.clear();
+		ends.reserve(endstate.size());
+		vector<pair<IndexType, bool>> stack = {{0, false}};
+		while (stack.size() > 0)
+		{
+			auto [i, done] = stack.back();
+			stack.pop_back();
+			if (done)
+			{
+				sliceend[i] = ends.size();
+				continue;
+			}
+			slicestart[i] = ends.size();
+			ends.insert(ends.end(), buckets.begin() + bucketoffsets[i], buckets.begin() + bucketoffsets[i + 1]);
+			stack.push_back({i, true});
+			for (auto& j : sa.suffixreferences[i])
+			{
+				stack.push_back({j, false});
+			}
+		}
+		// Each document marks the link chains above its prefix ends, stopping
+		// at a state it has already marked
+		documentfrequency.assign(n, 0);
+		vector<int> lastdocument(n, -1);
+		for (int d = 0; d < documents(); d++)
+		{
+			IndexType stop = d + 1 < documents() ? documentstart[d + 1] : endstate.size();
+			for (IndexType g = documentstart[d]; g < stop; g++)
+			{
+				for (IndexType i = endstate[g]; i != -1 && lastdocument[i] != d; i = sa.link[i])
+				{
+					lastdocument[i] = d;
+					documentfrequency[i]++;
+				}
+			}
+		}
+		indexed = true;
+	}
+
+	// Returns the state reached by s, or -1
+	IndexType Walk(string_view s) const
+	{
+		IndexType next = 0;
+		for (auto& c : s)
+		{
+			next = sa.transitions.GetTransition(next, c);
+			if (next == -1) return -1;
+		}
+		return next;
+	}
+	// O(s) query to see if any document contains a substring s
+	bool contains(string_view s) const
+	{
+		return Walk(s) != -1;
+	}
+	// Returns the number of documents containing a non-empty string s
+	int DocumentFrequency(string_view s)
+	{
+		if (!indexed) Index();
+		IndexType next = Walk(s);
+		return next == -1 ? 0 : documentfrequency[next];
+	}
+	// Returns the number of occurrences of a non-empty string s across all
+	// documents in O(s)
+	IndexType count(string_view s)
+	{
+		if (!indexed) Index();
+		IndexType next = Walk(s);
+		return next == -1 ? 0 : sliceend[next] - slicestart[next];
+	}
+	// Return the (document id, offset) of every occurrence of a non-empty
+	// string s, in document then offset order
+	vector<pair<int, IndexType>> positions(string_view s)
+	{
+		if (!indexed) Index();
+		IndexType next = Walk(s);
+		if (next == -1) return {};
+		vector<IndexType> g(ends.begin() + slicestart[next], ends.begin() + sliceend[next]);
+		sort(g.begin(), g.end());
+		vector<pair<int, IndexType>> p;
+		p.reserve(g.size());
+		IndexType sz = s.size();
+		for (auto& i : g)
+		{
+			int d = DocumentOf(i);
+			p.push_back({d, i - documentstart[d] - sz + 1});
+		}
+		return p;
+	}
+	// Return the ids of the documents containing a non-empty string s
+	vector<int> documentsof(string_view s)
+	{
+		vector<int> d;
+		for (auto& p : positions(s))
+		{
+			if (d.empty() || d.back() != p.first) d.push_back(p.first);
+		}
+		return d;
+	}
+};
+
+typedef BasicGeneralizedSuffixAutomaton<LinearStore> GeneralizedSuffixAutomaton;
+#endif
@@ -0,0 +1,114 @@
+#ifndef MATCHINGSTATISTICS_H
+#define MATCHINGSTATISTICS_H
+#include <string_view>
+#include <cstdint>
+#include "FrozenSuffixAutomaton.h"
+using namespace std;
+
+// The longest common substring of a streamed text and the reference text of
+// an automaton: text[textstart, textstart + length) occurs in the reference
+// at referencestart. Reference positions and lengths are of the Index type of
+// the reference automaton.
+template <class Index = int>
+struct BasicCommonSubstring {
+	int64_t textstart = 0;
+	Index referencestart = 0;
+	Index length = 0;
+};
+typedef BasicCommonSubstring<> CommonSubstring;
+
+// Streams a second text through a frozen or mapped automaton of a reference
+// text, computing its matching statistics: after each character, the length
+// of the longest substring ending there that occurs in the reference, and the
+// state it reaches. The text may arrive in chunks of any size, and the stream
+// keeps only the current state, match length and best match, so memory does
+// not grow with the text.
+//
+// When the next character has no transition we fall back along suffix links,
+// each of which shortens the match to the len of its target, until one does.
+// A character moves forward by one and every fallback shortens the match, so
+// the whole text costs amortized O(1) per character.
+template <class I = int>
+struct BasicMatchingStatistics {
+	typedef I Index;
+	const BasicFrozenView<Index>* fa;
+	Index state = 0;
+	Index length = 0;
+	// Number of characters consumed so far
+	int64_t position = 0;
+	BasicCommonSubstring<Index> longest;
+
+	BasicMatchingStatistics(const BasicFrozenView<Index>& fa)
+		: fa(&fa)
+	{
+	}
+	// Consumes c and returns the length of the longest match ending at it
+	Index Step(char c)
+	{
+		Index next = fa->GetTransition(state, c);
+		while (next == -1 && state != 0)
+		{
+			state = fa->link[state];
+			length = fa->len[state];
+			next = fa->GetTransition(state, c);
+		}
+		if (next == -1) length = 0;
+		else
+		{
+			state = next;
+			length++;
+		}
+		position++;
+		if (length > longest.length)
+		{
+			longest.length = length;
+			longest.textstart = position - length;
+			longest.referencestart = fa->firstpos[state] - length + 1;
+		}
+		return length;
+	}
+	// Consumes a chunk of the text, calling f(position, length, state) after
+	// each character, where position is that character's offset in the whole
+	// text
+	template <class F>
+	void Feed(string_view chunk, F f)
+	{
+		for (auto& c : chunk)
+		{
+			Step(c);
+			f(position - 1, length, state);
+		}
+	}
+	// Consumes a chunk of the text, only keeping the longest match
+	void Feed(string_view chunk)
+	{
+		for (auto& c : chunk)
+		{
+			Step(c);
+		}
+	}
+	// Starts a new text, keeping the reference automaton
+	void Reset()
+	{
+		state = 0;
+		length = 0;
+		position = 0;
+		longest = BasicCommonSubstring<Index>();
+	}
+};
+
+// Lets BasicMatchingStatistics m(view) take the index type of the view
+template <class Index>
+BasicMatchingStatistics(const BasicFrozenView<Index>&) -> BasicMatchingStatistics<Index>;
+
+typedef BasicMatchingStatistics<> MatchingStatistics;
+
+// Returns the longest common substring of text and the reference text of fa
+template <class Index>
+BasicCommonSubstring<Index> LongestCommonSubstring(const BasicFrozenView<Index>& fa, string_view text)
+{
+	BasicMatchingStatistics<Index> m(fa);
+	m.Feed(text);
+	return m.longest;
+}
+#endif
@@ -0,0 +1,483 @@
+#ifndef PARALLELBUILD_H
+#define PARALLELBUILD_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include "BatchQuery.h"
+#include "GeneralizedSuffixAutomaton.h"
+using namespace std;
+
+// Builds a generalized automaton of many documents on every thread of a
+// QueryPool. The documents are cut into one contiguous shard per thread,
+// each shard is built on its own, and the shards are merged pairwise until
+// one is left. The result has the same states, lengths, links and edges as
+// adding the documents one by one with AddDocument, and answers every query
+// the same way, though its states are numbered differently.
+//
+// Merging two shards A and B rests on one fact: a string's state in the
+// automaton of both is fixed by its endpos sets in A and in B, so the states
+// of the merge are exactly the pairs (state in A, state in B) reached by
+// some string, with -1 where the string does not occur. Each pair is found
+// without a search of the product:
+// - Streaming each document of A through B, as MatchingStatistics does,
+//   gives for every prefix the longest suffix of it that occurs in B.
+// - Going up A's link tree from the prefix ends, each state p learns m, the
+//   longest suffix of its longest string that occurs in B. This also gives
+//   the state of B that holds that suffix.
+// - The strings of p are the suffixes of its longest string with lengths in
+//   (len[link[p]], len[p]]. Those longer than m form the pair (p, -1). The
+//   rest are split among the states on B's link chain below m, one pair per
+//   state. These pairs are p's partners.
+// - The same is done from B, keeping only the (-1, q) pairs.
+// The len, link and edges of every pair follow from those of its two halves.
+// Every step but the walk up the link tree runs on all threads. That walk is
+// linear: each state climbs B's link tree only past the partners of the
+// child it starts from.
+
+// Ranges of at least this many states or prefixes are handed out to threads
+const size_t buildgrain = 4096;
+
+// Runs f(begin, end) on consecutive ranges covering [0, count) on the pool
+template <class F>
+void ParallelRanges(QueryPool& pool, size_t count, F f)
+{
+	size_t chunks = (count + buildgrain - 1) / buildgrain;
+	pool.ParallelFor(chunks, [&](int chunk)
+	{
+		f(chunk * buildgrain, min(count, (chunk + 1) * buildgrain));
+	});
+}
+
+// The automaton of documents [firstdocument, enddocument), with its edges
+// packed as in FrozenView and endstate as in BasicGeneralizedSuffixAutomaton
+template <class Index>
+struct DocumentShard {
+	int firstdocument = 0;
+	int enddocument = 0;
+	vector<Index> len;
+	vector<Index> link;
+	vector<Index> firstpos;
+	vector<Index> offsets;
+	vector<char> labels;
+	vector<Index> targets;
+	vector<Index> endstate;
+
+	Index size() const
+	{
+		return len.size();
+	}
+	Index GetTransition(Index i, char c) const
+	{
+		int j = FindLabel(labels.data() + offsets[i], offsets[i + 1] - offsets[i], c);
+		return j == -1 ? -1 : targets[offsets[i] + j];
+	}
+	// Builds documents [first, end) one by one and packs the automaton
+	template <class Store, class Documents>
+	DocumentShard(const Documents& documents, int first, int end, Store store)
+		: firstdocument(first), enddocument(end)
+	{
+		BasicSuffixAutomaton<Store> sa(move(store));
+		size_t chars = 0;
+		for (int d = first; d < end; d++)
+		{
+			chars += string_view(documents[d]).size();
+		}
+		sa.Reserve(chars);
+		endstate.reserve(chars);
+		for (int d = first; d < end; d++)
+		{
+			sa.StartDocument();
+			for (auto& c : string_view(documents[d]))
+			{
+				sa.extend(c);
+				endstate.push_back(sa.last);
+			}
+		}
+		Index n = sa.size();
+		len = sa.len;
+		link = sa.link;
+		firstpos = sa.firstpos;
+		offsets.resize(n + 1);
+		vector<pair<unsigned char, Index>> edges;
+		for (Index i = 0; i < n; i++)
+		{
+			offsets[i] = labels.size();
+			edges.clear();
+			sa.transitions.ForEach(i, [&](char c, Index t) { edges.push_back({c, t}); });
+			sort(edges.begin(), edges.end());
+			for (auto& [c, t] : edges)
+			{
+				labels.push_back(c);
+				targets.push_back(t);
+			}
+		}
+		offsets[n] = labels.size();
+	}
+	DocumentShard() {}
+};
+
+// Where the strings of each state of x stand in y: state p of x gets the
+// length of the longest suffix of its longest string that occurs in y, and
+// the state of y holding that suffix
+template <class Index>
+struct ShardMatches {
+	vector<Index> length;
+	vector<Index> state;
+
+	template <class Documents>
+	ShardMatches(QueryPool& pool, const Documents& documents, const DocumentShard<Index>& x, const DocumentShard<Index>& y)
+	{
+		// The matching statistics of every prefix of x, streamed a document
+		// at a time
+		vector<size_t> starts = {0};
+		for (int d = x.firstdocument; d < x.enddocument; d++)
+		{
+			starts.push_back(starts.back() + string_view(documents[d]).size());
+		}
+		vector<Index> prefixlength(x.endstate.size());
+		vector<Index> prefixstate(x.endstate.size());
+		pool.ParallelFor(x.enddocument - x.firstdocument, [&](int k)
+		{
+			Index s = 0;
+			Index m = 0;
+			size_t g = starts[k];
+			for (auto& c : string_view(documents[x.firstdocument + k]))
+			{
+				Index next = y.GetTransition(s, c);
+				while (next == -1 && s != 0)
+				{
+					s = y.link[s];
+					m = y.len[s];
+					next = y.GetTransition(s, c);
+				}
+				if (next == -1) m = 0;
+				else
+				{
+					s = next;
+					m++;
+				}
+				prefixlength[g] = m;
+				prefixstate[g] = s;
+				g++;
+			}
+		});
+		// A state that ends a prefix takes that prefix's statistics. Any
+		// other state has at least two children in the link tree, its
+		// longest string is a suffix of theirs, and it takes the first
+		// child's, shortened to its own len.
+		Index n = x.size();
+		length.assign(n, 0);
+		state.assign(n, 0);
+		vector<char> known(n, 0);
+		known[0] = 1;
+		for (size_t g = 0; g < x.endstate.size(); g++)
+		{
+			Index p = x.endstate[g];
+			if (known[p]) continue;
+			known[p] = 1;
+			length[p] = prefixlength[g];
+			state[p] = prefixstate[g];
+		}
+		vector<Index> from(n, -1);
+		vector<Index> order = OrderByLen(x.len);
+		for (Index k = n - 1; k > 0; k--)
+		{
+			Index p = order[k];
+			if (!known[p])
+			{
+				Index child = from[p];
+				Index m = min(length[child], x.len[p]);
+				Index s = state[child];
+				while (s != 0 && y.len[y.link[s]] >= m)
+				{
+					s = y.link[s];
+				}
+				length[p] = m;
+				state[p] = s;
+				known[p] = 1;
+			}
+			if (!known[x.link[p]] && from[x.link[p]] == -1) from[x.link[p]] = p;
+		}
+	}
+};
+
+// Merges shard a with the shard b of the documents that follow it
+template <class Index, class Documents>
+DocumentShard<Index> MergeShards(QueryPool& pool, const Documents& documents, const DocumentShard<Index>& a, const DocumentShard<Index>& b)
+{
+	ShardMatches<Index> ina(pool, documents, a, b);
+	ShardMatches<Index> inb(pool, documents, b, a);
+	Index na = a.size();
+	Index nb = b.size();
+	// Calls f(s) for each state s of b on p's partner chain
+	auto chain = [&](Index p, auto f)
+	{
+		Index m = ina.length[p];
+		Index s = ina.state[p];
+		while (m > a.len[a.link[p]])
+		{
+			f(s);
+			s = b.link[s];
+			m = b.len[s];
+		}
+	};
+	// Number the pairs: the partners of each state of a in turn, with
+	// (p, -1) first and the rest in decreasing len, then the (-1, q) pairs
+	vector<Index> base(na + 1, 0);
+	vector<Index> bonly(nb, -1);
+	ParallelRanges(pool, na, [&](size_t begin, size_t end)
+	{
+		for (Index p = begin; p < end; p++)
+		{
+			if (p == 0)
+			{
+				base[1] = 1;
+				continue;
+			}
+			Index count = ina.length[p] < a.len[p];
+			chain(p, [&](Index s) { count++; });
+			base[p + 1] = count;
+		}
+	});
+	for (Index p = 0; p < na; p++)
+	{
+		base[p + 1] += base[p];
+	}
+	Index n = base[na];
+	for (Index q = 1; q < nb; q++)
+	{
+		if (inb.length[q] < b.len[q]) bonly[q] = n++;
+	}
+	vector<Index> first(n, -1);
+	vector<Index> second(n, -1);
+	ParallelRanges(pool, na, [&](size_t begin, size_t end)
+	{
+		for (Index p = begin; p < end; p++)
+		{
+			Index id = base[p];
+			if (p == 0)
+			{
+				first[0] = second[0] = 0;
+				continue;
+			}
+			if (ina.length[p] < a.len[p]) first[id++] = p;
+			chain(p, [&](Index s)
+			{
+				first[id] = p;
+				second[id++] = s;
+			});
+		}
+	});
+	ParallelRanges(pool, nb, [&](size_t begin, size_t end)
+	{
+		for (Index q = begin; q < end; q++)
+		{
+			if (bonly[q] != -1) second[bonly[q]] = q;
+		}
+	});
+	// The pair (p, q), which must exist
+	auto find = [&](Index p, Index q)
+	{
+		if (p == -1) return bonly[q];
+		Index lo = base[p];
+		Index hi = base[p + 1];
+		if (second[lo] == -1)
+		{
+			if (q == -1) return lo;
+			lo++;
+		}
+		// Partners of p are in decreasing len of their state in b
+		while (hi - lo > 1)
+		{
+			Index mid = lo + (hi - lo) / 2;
+			if (b.len[second[mid]] >= b.len[q]) lo = mid;
+			else hi = mid;
+		}
+		return lo;
+	};
+	// Calls f(c, i, j) for every label c on an edge of p in a or of q in b,
+	// with i and j the indices of those edges, or -1
+	auto edges = [&](Index p, Index q, auto f)
+	{
+		Index i = p == -1 ? 0 : a.offsets[p];
+		Index iend = p == -1 ? 0 : a.offsets[p + 1];
+		Index j = q == -1 ? 0 : b.offsets[q];
+		Index jend = q == -1 ? 0 : b.offsets[q + 1];
+		while (i < iend || j < jend)
+		{
+			int ca = i < iend ? (unsigned char)a.labels[i] : 256;
+			int cb = j < jend ? (unsigned char)b.labels[j] : 256;
+			if (ca < cb) f((char)ca, i++, (Index)-1);
+			else if (cb < ca) f((char)cb, (Index)-1, j++);
+			else f((char)ca, i++, j++);
+		}
+	};
+	DocumentShard<Index> m;
+	m.firstdocument = a.firstdocument;
+	m.enddocument = b.enddocument;
+	m.len.resize(n);
+	m.link.resize(n);
+	m.firstpos.resize(n);
+	m.offsets.assign(n + 1, 0);
+	ParallelRanges(pool, n, [&](size_t begin, size_t end)
+	{
+		for (Index id = begin; id < end; id++)
+		{
+			Index p = first[id];
+			Index q = second[id];
+			Index degree = 0;
+			edges(p, q, [&](char c, Index i, Index j) { degree++; });
+			m.offsets[id + 1] = degree;
+			m.firstpos[id] = p != -1 ? a.firstpos[p] : b.firstpos[q];
+			if (id == 0)
+			{
+				m.len[0] = 0;
+				m.link[0] = -1;
+				continue;
+			}
+			// The strings of the pair have lengths in (lower, len], and its
+			// link is the pair of the suffix of length lower
+			Index alower = p == -1 ? inb.length[q] : a.len[a.link[p]];
+			Index blower = q == -1 ? ina.length[p] : b.len[b.link[q]];
+			Index lower = max(alower, blower);
+			if (p == -1) m.len[id] = b.len[q];
+			else if (q == -1) m.len[id] = a.len[p];
+			else m.len[id] = min(ina.length[p], b.len[q]);
+			Index ap = p == -1 ? (lower > alower ? -1 : inb.state[q]) : (lower > alower ? p : a.link[p]);
+			Index bq = q == -1 ? (lower > blower ? -1 : ina.state[p]) : (lower > blower ? q : b.link[q]);
+			m.link[id] = find(ap, bq);
+		}
+	});
+	for (Index id = 0; id < n; id++)
+	{
+		m.offsets[id + 1] += m.offsets[id];
+	}
+	m.labels.resize(m.offsets[n]);
+	m.targets.resize(m.offsets[n]);
+	ParallelRanges(pool, n, [&](size_t begin, size_t end)
+	{
+		for (Index id = begin; id < end; id++)
+		{
+			Index e = m.offsets[id];
+			edges(first[id], second[id], [&](char c, Index i, Index j)
+			{
+				m.labels[e] = c;
+				m.targets[e++] = find(i == -1 ? -1 : a.targets[i], j == -1 ? -1 : b.targets[j]);
+			});
+		}
+	});
+	// A prefix is the longest string of its state. In a, that is p's first
+	// partner. In b, it is found through the prefix's match in a.
+	m.endstate.resize(a.endstate.size() + b.endstate.size());
+	ParallelRanges(pool, a.endstate.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; g++)
+		{
+			m.endstate[g] = base[a.endstate[g]];
+		}
+	});
+	ParallelRanges(pool, b.endstate.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; g++)
+		{
+			Index q = b.endstate[g];
+			m.endstate[a.endstate.size() + g] = inb.length[q] == b.len[q] ? find(inb.state[q], q) : bonly[q];
+		}
+	});
+	return m;
+}
+
+// Returns the generalized automaton of documents, any random-access container
+// of strings or string_views, built on every thread of pool. If the documents
+// would overflow the index they are added one by one, so that AddDocument
+// refuses the same ones it would have. Clone flags mark the states that end
+// no prefix of a document.
+template <class Store = LinearStore, class Documents>
+BasicGeneralizedSuffixAutomaton<Store> ParallelBuild(QueryPool& pool, const Documents& documents, Store store = Store())
+{
+	typedef typename Store::IndexType Index;
+	BasicGeneralizedSuffixAutomaton<Store> g;
+	g.sa = BasicSuffixAutomaton<Store>(store);
+	int count = documents.size();
+	size_t chars = 0;
+	for (auto& d : documents)
+	{
+		chars += string_view(d).size();
+	}
+	int shards = min(pool.size(), count);
+	if (shards <= 1 || !g.sa.Fits(chars))
+	{
+		for (auto& d : documents)
+		{
+			g.AddDocument(d);
+		}
+		return g;
+	}
+	// Cut the documents into shards of about the same number of characters
+	vector<int> cuts = {0};
+	size_t sofar = 0;
+	for (int d = 0; d < count; d++)
+	{
+		sofar += string_view(documents[d]).size();
+		if (sofar * shards >= chars * cuts.size() && cuts.size() < shards) cuts.push_back(d + 1);
+	}
+	cuts.push_back(count);
+	cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+	vector<DocumentShard<Index>> level(cuts.size() - 1);
+	pool.ParallelFor(level.size(), [&](int k)
+	{
+		level[k] = DocumentShard<Index>(documents, cuts[k], cuts[k + 1], store);
+	});
+	while (level.size() > 1)
+	{
+		vector<DocumentShard<Index>> merged;
+		for (size_t k = 0; k + 1 < level.size(); k += 2)
+		{
+			merged.push_back(MergeShards(pool, documents, level[k], level[k + 1]));
+			level[k] = DocumentShard<Index>();
+			level[k + 1] = DocumentShard<Index>();
+		}
+		if (level.size() % 2 == 1) merged.push_back(move(level.back()));
+		level = move(merged);
+	}
+	// Copy the merged automaton into the store
+	DocumentShard<Index>& m = level[0];
+	BasicSuffixAutomaton<Store>& sa = g.sa;
+	Index n = m.size();
+	sa.Reserve(chars);
+	for (Index i = 1; i < n; i++)
+	{
+		sa.AddState(m.len[i]);
+		sa.clone[i] = true;
+	}
+	for (Index i = 0; i < n; i++)
+	{
+		sa.link[i] = m.link[i];
+		sa.firstpos[i] = m.firstpos[i];
+		for (Index e = m.offsets[i]; e < m.offsets[i + 1]; e++)
+		{
+			sa.transitions.AddTransition(i, m.labels[e], m.targets[e]);
+		}
+	}
+	for (auto& i : m.endstate)
+	{
+		sa.clone[i] = false;
+	}
+	// The links were copied directly, so the children are built from them
+	sa.ComputeSuffixReferences();
+	// As after AddDocument, last is the end of the last document, or the
+	// root if that document is empty
+	sa.last = string_view(documents[count - 1]).empty() ? 0 : m.endstate.back();
+	sa.terminalsdirty = true;
+	sa.characters = chars;
+	size_t start = 0;
+	for (auto& d : documents)
+	{
+		g.documentstart.push_back(start);
+		start += string_view(d).size();
+	}
+	g.endstate = move(m.endstate);
+	return g;
+}
+#endif
@@ -0,0 +1,91 @@
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <limits>
+#include <cstdint>
+#include "FrozenSuffixAutomaton.h"
+#include "WaveletMatrix.h"
+using namespace std;
+
+// A one-time index that answers sorted, paginated and range-restricted
+// position queries on a frozen or mapped automaton without a per-query DFS
+// or sort.
+//
+// A preorder DFS of the link tree lists the end position of every non-clone
+// state, so the end positions below any state i form the contiguous slice
+// [in[i], in[i] + occurrences[i]) of that list. The list is stored as a
+// wavelet matrix, which enumerates any slice in increasing order and counts
+// or reports just the values inside a range. Positions are of the
+// automaton's Index type.
+template <class I = int>
+struct BasicPositionIndex {
+	typedef I Index;
+	vector<Index> in;
+	BasicWaveletMatrix<Index> ends;
+
+	BasicPositionIndex(const BasicFrozenView<Index>& fa)
+	{
+		in.assign(fa.n, 0);
+		vector<Index> euler;
+		euler.reserve(fa.n);
+		Index maxend = 0;
+		vector<Index> stack = {0};
+		while (stack.size() > 0)
+		{
+			Index i = stack.back();
+			stack.pop_back();
+			in[i] = euler.size();
+			if (i != 0 && !fa.IsClone(i))
+			{
+				euler.push_back(fa.firstpos[i]);
+				maxend = max(maxend, fa.firstpos[i]);
+			}
+			for (Index j = fa.childoffsets[i]; j < fa.childoffsets[i + 1]; j++)
+			{
+				stack.push_back(fa.children[j]);
+			}
+		}
+		ends = BasicWaveletMatrix<Index>(move(euler), maxend);
+	}
+	// The end position of a string of length sz starting at x, as a bound
+	// for the wavelet matrix. A bound past the largest position is the same
+	// as none, so it saturates rather than overflowing a 64-bit Index.
+	static int64_t EndBound(Index x, Index sz)
+	{
+		return (int64_t)x > numeric_limits<int64_t>::max() - (int64_t)sz ? numeric_limits<int64_t>::max() : (int64_t)x + sz - 1;
+	}
+	// Returns the sorted positions of a non-empty string s that start in
+	// [lo, hi), skipping the first offset of them and returning at most limit
+	vector<Index> positions(const BasicFrozenView<Index>& fa, string_view s, Index offset = 0, Index limit = numeric_limits<Index>::max(), Index lo = 0, Index hi = numeric_limits<Index>::max()) const
+	{
+		vector<Index> p;
+		Index next = fa.Walk(s);
+		if (next == -1 || limit <= 0) return p;
+		Index sz = s.size();
+		int64_t skip = offset;
+		ends.Enumerate(in[next], in[next] + fa.occurrences[next], EndBound(lo, sz), EndBound(hi, sz), skip, [&](Index end)
+		{
+			p.push_back(end - sz + 1);
+			return p.size() < limit;
+		});
+		return p;
+	}
+	// Returns the number of occurrences of a non-empty string s that start
+	// in [lo, hi), in O(s + log n)
+	Index count(const BasicFrozenView<Index>& fa, string_view s, Index lo, Index hi) const
+	{
+		Index next = fa.Walk(s);
+		if (next == -1) return 0;
+		Index sz = s.size();
+		return ends.CountRange(in[next], in[next] + fa.occurrences[next], EndBound(lo, sz), EndBound(hi, sz));
+	}
+};
+
+// Lets BasicPositionIndex index(view) take the index type of the view
+template <class Index>
+BasicPositionIndex(const BasicFrozenView<Index>&) -> BasicPositionIndex<Index>;
+
+typedef BasicPositionIndex<> PositionIndex;
+#endif
@@ -0,0 +1,180 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <algorithm>
+#include <cstdint>
+using namespace std;
+
+// Event counters for automata built with the Counting flag, such as
+// BasicSuffixAutomaton<LinearStore, true>, and for the frozen views from
+// FrozenView::Counted() and the batch queries run on them. Without the flag
+// every call site is discarded at compile time, so the default automaton
+// pays nothing.
+//
+// Each thread bumps its own block of counters, so counting needs no locks or
+// shared cache lines. ReadStatistics() sums the blocks of every live thread
+// and the totals of threads that have exited.
+enum Counter {
+	LinkClimbs,       // Suffix links followed while adding a character
+	TransitionsAdded, // Edges created by extend
+	Clones,           // States created by Split
+	Redirects,        // Edges redirected to a clone by Split
+	BuildLookups,     // Transition lookups during construction
+	Queries,          // Walks made by contains, first, count and positions
+	QueryHops,        // Transitions followed by those walks
+	PositionVisits,   // Link tree states visited to report positions
+	counters
+};
+
+inline const char* CounterName(int c)
+{
+	static const char* names[] = {"linkclimbs", "transitionsadded", "clones", "redirects", "buildlookups", "queries", "queryhops", "positionvisits"};
+	return names[c];
+}
+
+// Histograms are kept in power of two buckets: bucket 0 counts zeros and
+// bucket b counts values in [2^(b-1), 2^b)
+const int histogrambuckets = 33;
+
+inline int HistogramBucket(uint64_t x)
+{
+	return x == 0 ? 0 : min(64 - __builtin_clzll(x), histogrambuckets - 1);
+}
+
+// A consistent copy of the counters
+struct StatisticsSnapshot {
+	uint64_t counts[counters] = {};
+	// The degree of the state searched by each lookup during construction
+	uint64_t lookupdegree[histogrambuckets] = {};
+	// The number of transitions followed by each query
+	uint64_t hopsperquery[histogrambuckets] = {};
+
+	// Writes one name,value line per counter and non-empty bucket
+	void Dump(ostream& out) const
+	{
+		for (int c = 0; c < counters; c++)
+		{
+			out << CounterName(c) << "," << counts[c] << "\n";
+		}
+		for (int b = 0; b < histogrambuckets; b++)
+		{
+			if (lookupdegree[b] > 0) out << "lookupdegree[" << BucketLow(b) << "]," << lookupdegree[b] << "\n";
+		}
+		for (int b = 0; b < histogrambuckets; b++)
+		{
+			if (hopsperquery[b] > 0) out << "hopsperquery[" << BucketLow(b) << "]," << hopsperquery[b] << "\n";
+		}
+	}
+	static uint64_t BucketLow(int b)
+	{
+		return b == 0 ? 0 : (uint64_t)1 << (b - 1);
+	}
+};
+
+// One thread's counters. Only the owning thread writes them, so a relaxed
+// load and store is enough, and readers on other threads never see a torn
+// value.
+struct StatisticsBlock {
+	atomic<uint64_t> counts[counters] = {};
+	atomic<uint64_t> lookupdegree[histogrambuckets] = {};
+	atomic<uint64_t> hopsperquery[histogrambuckets] = {};
+
+	static void Bump(atomic<uint64_t>& x, uint64_t n)
+	{
+		x.store(x.load(memory_order_relaxed) + n, memory_order_relaxed);
+	}
+	void AddTo(StatisticsSnapshot& s) const
+	{
+		for (int c = 0; c < counters; c++)
+		{
+			s.counts[c] += counts[c].load(memory_order_relaxed);
+		}
+		for (int b = 0; b < histogrambuckets; b++)
+		{
+			s.lookupdegree[b] += lookupdegree[b].load(memory_order_relaxed);
+			s.hopsperquery[b] += hopsperquery[b].load(memory_order_relaxed);
+		}
+	}
+	void Clear()
+	{
+		for (auto& x : counts) x.store(0, memory_order_relaxed);
+		for (auto& x : lookupdegree) x.store(0, memory_order_relaxed);
+		for (auto& x : hopsperquery) x.store(0, memory_order_relaxed);
+	}
+};
+
+// The blocks of live threads, and the merged counts of exited ones
+inline mutex statisticsmutex;
+inline vector<StatisticsBlock*> statisticsblocks;
+inline StatisticsSnapshot retiredstatistics;
+
+// Registers a thread's block on its first count and retires it on exit
+struct ThreadStatistics {
+	StatisticsBlock block;
+	ThreadStatistics()
+	{
+		lock_guard<mutex> lock(statisticsmutex);
+		statisticsblocks.push_back(&block);
+	}
+	~ThreadStatistics()
+	{
+		lock_guard<mutex> lock(statisticsmutex);
+		block.AddTo(retiredstatistics);
+		statisticsblocks.erase(find(statisticsblocks.begin(), statisticsblocks.end(), &block));
+	}
+};
+
+inline StatisticsBlock& LocalStatistics()
+{
+	thread_local ThreadStatistics t;
+	return t.block;
+}
+
+inline void CountEvent(Counter c, uint64_t n = 1)
+{
+	StatisticsBlock::Bump(LocalStatistics().counts[c], n);
+}
+
+inline void CountLookupDegree(int degree)
+{
+	StatisticsBlock& b = LocalStatistics();
+	StatisticsBlock::Bump(b.counts[BuildLookups], 1);
+	StatisticsBlock::Bump(b.lookupdegree[HistogramBucket(degree)], 1);
+}
+
+inline void CountQuery(int hops)
+{
+	StatisticsBlock& b = LocalStatistics();
+	StatisticsBlock::Bump(b.counts[Queries], 1);
+	StatisticsBlock::Bump(b.counts[QueryHops], hops);
+	StatisticsBlock::Bump(b.hopsperquery[HistogramBucket(hops)], 1);
+}
+
+// Sums the counters of every thread
+inline StatisticsSnapshot ReadStatistics()
+{
+	lock_guard<mutex> lock(statisticsmutex);
+	StatisticsSnapshot s = retiredstatistics;
+	for (auto& b : statisticsblocks)
+	{
+		b->AddTo(s);
+	}
+	return s;
+}
+
+// Zeroes the counters of every thread. Counts made while this runs may be
+// lost.
+inline void ResetStatistics()
+{
+	lock_guard<mutex> lock(statisticsmutex);
+	retiredstatistics = StatisticsSnapshot();
+	for (auto& b : statisticsblocks)
+	{
+		b->Clear();
+	}
+}
+#endif
@@ -0,0 +1,82 @@
+#ifndef SUBSTRINGSTATISTICS_H
+#define SUBSTRINGSTATISTICS_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "FrozenSuffixAutomaton.h"
+using namespace std;
+
+// Counts of the distinct substrings of a frozen or mapped automaton's text,
+// and the k-th of them in lexicographic order.
+//
+// Every distinct substring is exactly one path from the root, so paths[i],
+// the number of non-empty paths leaving state i, counts the distinct strings
+// that extend those of i. An edge always leads to a longer state, so states
+// in decreasing order of len are a topological order of the DAG, which
+// OrderByLen gives in linear time without recursion. A text of n characters
+// has at most n(n+1)/2 substrings, so counts are 64-bit. The automaton may be
+// of any index type.
+struct SubstringStatistics {
+	vector<int64_t> paths;
+
+	template <class Index>
+	SubstringStatistics(const BasicFrozenView<Index>& fa)
+	{
+		Index n = fa.n;
+		vector<Index> order = OrderByLen(fa.len, n);
+		paths.assign(n, 0);
+		for (Index k = n; k > 0; k--)
+		{
+			Index i = order[k - 1];
+			int64_t p = 0;
+			for (Index e = fa.offsets[i]; e < fa.offsets[i + 1]; e++)
+			{
+				p += 1 + paths[fa.targets[e]];
+			}
+			paths[i] = p;
+		}
+	}
+	// Returns the number of distinct non-empty substrings of the text
+	int64_t distinct() const
+	{
+		return paths.empty() ? 0 : paths[0];
+	}
+	// Returns the number of distinct non-empty substrings of the text that
+	// start with s, in O(s)
+	template <class Index>
+	int64_t DistinctWithPrefix(const BasicFrozenView<Index>& fa, string_view s) const
+	{
+		Index next = fa.Walk(s);
+		if (next == -1) return 0;
+		return (s.size() > 0) + paths[next];
+	}
+	// Returns the k-th smallest distinct substring in lexicographic order,
+	// counting from 1, or an empty string if k is out of range. Each
+	// character costs one pass over the sorted edges of a state.
+	template <class Index>
+	string KthSubstring(const BasicFrozenView<Index>& fa, int64_t k) const
+	{
+		string s;
+		if (k < 1 || k > distinct()) return s;
+		Index i = 0;
+		while (k > 0)
+		{
+			for (Index e = fa.offsets[i]; e < fa.offsets[i + 1]; e++)
+			{
+				Index t = fa.targets[e];
+				// The string ending at this edge, then every extension of it
+				if (k <= 1 + paths[t])
+				{
+					s.push_back(fa.labels[e]);
+					k--;
+					i = t;
+					break;
+				}
+				k -= 1 + paths[t];
+			}
+		}
+		return s;
+	}
+};
+#endif
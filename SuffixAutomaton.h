@@ -0,0 +1,630 @@
+#ifndef SUFFIXAUTOMATON_H
+#define SUFFIXAUTOMATON_H
+#include <vector>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <queue>
+#include <limits>
+#include <cstdint>
+#include "TransitionStores.h"
+#include "Statistics.h"
+using namespace std;
+
+// Returns the n states in increasing order of len, by a counting sort. The
+// lens may be those of a frozen or mapped automaton.
+template <class Index>
+vector<Index> OrderByLen(const Index* len, Index n)
+{
+	Index maxlen = 0;
+	for (Index i = 0; i < n; i++)
+	{
+		maxlen = max(maxlen, len[i]);
+	}
+	vector<Index> bylen((size_t)maxlen + 2, 0);
+	for (Index i = 0; i < n; i++)
+	{
+		bylen[len[i] + 1]++;
+	}
+	for (Index l = 0; l <= maxlen; l++)
+	{
+		bylen[l + 1] += bylen[l];
+	}
+	vector<Index> order(n);
+	for (Index i = 0; i < n; i++)
+	{
+		order[bylen[len[i]]++] = i;
+	}
+	return order;
+}
+
+template <class Index>
+vector<Index> OrderByLen(const vector<Index>& len)
+{
+	return OrderByLen(len.data(), (Index)len.size());
+}
+
+// Returns the number of occurrences of the strings of every state, i.e. the
+// size of its endpos set. Every non-clone state other than the root marks
+// one end position, and a state's occurrences are those of its whole link
+// subtree. Children are longer than their parents, so in decreasing order of
+// len each state is final before it is added to its parent.
+template <class Index>
+vector<Index> CountOccurrences(const vector<Index>& len, const vector<Index>& link, const vector<bool>& clone)
+{
+	Index n = len.size();
+	vector<Index> order = OrderByLen(len);
+	vector<Index> occurrences(n);
+	for (Index i = 1; i < n; i++)
+	{
+		occurrences[i] = clone[i] ? 0 : 1;
+	}
+	for (Index k = n - 1; k > 0; k--)
+	{
+		Index i = order[k];
+		occurrences[link[i]] += occurrences[i];
+	}
+	return occurrences;
+}
+
+// Visits the link subtree of root depth first, calling f(i) for each state
+// i, and stops as soon as f returns false. degree(i) and child(i, j) give the
+// children of i. The stack only holds the unvisited children of the states
+// on the current path, so memory grows with the depth and branching of the
+// subtree rather than the number of states in it. Returns false if f stopped
+// the walk.
+template <class Index, class Degree, class Child, class F>
+bool VisitLinkSubtree(Index root, Degree degree, Child child, F f)
+{
+	vector<Index> stack = {root};
+	while (stack.size() > 0)
+	{
+		Index i = stack.back();
+		stack.pop_back();
+		if (!f(i)) return false;
+		for (int j = degree(i) - 1; j >= 0; j--)
+		{
+			stack.push_back(child(i, j));
+		}
+	}
+	return true;
+}
+
+// Calls f(end) for the end positions in the link subtree of root in
+// increasing order, stopping as soon as f returns false. The firstpos of a
+// state is the smallest end position in its subtree, so a heap of subtrees
+// keyed by firstpos yields the ends in order while only opening the subtrees
+// it has reached. Returns false if f stopped the walk.
+template <class Index, class Degree, class Child, class IsClone, class F>
+bool VisitEndsInOrder(Index root, const Index* firstpos, Degree degree, Child child, IsClone isclone, F f)
+{
+	priority_queue<pair<Index, Index>, vector<pair<Index, Index>>, greater<pair<Index, Index>>> heap;
+	heap.push({firstpos[root], root});
+	while (heap.size() > 0)
+	{
+		Index i = heap.top().second;
+		heap.pop();
+		if (i != 0 && !isclone(i) && !f(firstpos[i])) return false;
+		for (int j = 0; j < degree(i); j++)
+		{
+			Index c = child(i, j);
+			heap.push({firstpos[c], c});
+		}
+	}
+	return true;
+}
+
+// Bytes held by an automaton, by component. Used bytes are those holding
+// data; reserved bytes include the spare capacity of every allocation. The
+// difference is the slack that ShrinkToFit() can reclaim.
+struct MemoryReport {
+	MemoryUsage states;      // len, link, firstpos and the clone and terminal flags
+	MemoryUsage transitions; // The transition store or packed edges
+	MemoryUsage linktree;    // Children in the link tree
+	MemoryUsage occurrences; // endpos sizes for count()
+	MemoryUsage other;       // Construction bookkeeping
+	MemoryUsage text;        // The source text, if the automaton holds it
+
+	MemoryUsage total() const
+	{
+		MemoryUsage m = states;
+		m += transitions;
+		m += linktree;
+		m += occurrences;
+		m += other;
+		m += text;
+		return m;
+	}
+	// Writes one component,used,reserved line per component
+	void Dump(ostream& out) const
+	{
+		pair<const char*, MemoryUsage> rows[] = {{"states", states}, {"transitions", transitions}, {"linktree", linktree}, {"occurrences", occurrences}, {"other", other}, {"text", text}, {"total", total()}};
+		for (auto& [name, m] : rows)
+		{
+			out << name << "," << m.used << "," << m.reserved << "\n";
+		}
+	}
+};
+
+// A snapshot of a single state in our DFA, which represents an equivalence
+// class. The automaton itself stores each field in its own array.
+template <class Index = int>
+struct BasicState {
+	Index len;
+	Index link;
+	Index first;
+	bool clone;
+	bool terminal;
+};
+typedef BasicState<> State;
+
+// A suffix automaton whose transitions are kept in a Store, one of the
+// policies in TransitionStores.h. With Counting set, construction and queries
+// record the events listed in Statistics.h. States are stored as a struct of arrays:
+// state i is len[i], link[i], firstpos[i], clone[i] and terminal[i], so loops
+// that climb suffix links only touch the link and len arrays.
+//
+// States, lengths and positions are of the store's IndexType: int by default,
+// uint32_t to reach twice as far in the same memory, or int64_t for texts
+// beyond that. -1 is still the sentinel for no state or no position, so with
+// uint32_t it reads as the largest value. Text that would overflow the index
+// is refused by append and extend rather than built.
+template <class Store, bool Counting = false>
+struct BasicSuffixAutomaton {
+	typedef typename Store::IndexType Index;
+	// The longest text whose 2n-1 states and 3n-4 edges all fit in an Index
+	// while leaving its largest value free for the sentinel
+	static constexpr size_t maxtext = (size_t)numeric_limits<Index>::max() / 3;
+	vector<Index> len;
+	vector<Index> link;
+	vector<Index> firstpos;
+	vector<bool> clone;
+	vector<bool> terminal;
+	Store transitions;
+	// The children of each state in the link tree, for the position queries.
+	// They are kept up to date by every extend, so queries never build them.
+	bool hassuffixreferences = false;
+	vector<vector<Index>> suffixreferences;
+	// The size of each state's endpos set, counted by ComputeOccurrences()
+	// and out of date once more text is added
+	bool hasoccurrences = false;
+	vector<Index> occurrences;
+	// The state of the whole text so far
+	Index last = 0;
+	// Whether terminal is out of date, and the states it currently marks
+	bool terminalsdirty = false;
+	vector<Index> terminalstates;
+	// Characters added so far, over every document, and whether any text was
+	// refused for lack of room
+	size_t characters = 0;
+	bool overflowed = false;
+	// Returns the number of states
+	Index size() const
+	{
+		return len.size();
+	}
+	void Record(Counter c) const
+	{
+		if constexpr (Counting) CountEvent(c);
+	}
+	// GetTransition during construction
+	Index Lookup(Index i, char c) const
+	{
+		if constexpr (Counting) CountLookupDegree(transitions.Degree(i));
+		return transitions.GetTransition(i, c);
+	}
+	// Returns the state reached by s, or -1
+	Index Walk(string_view s) const
+	{
+		Index next = 0;
+		int hops = 0;
+		for (auto& c : s)
+		{
+			next = transitions.GetTransition(next, c);
+			if (next == -1) break;
+			hops++;
+		}
+		if constexpr (Counting) CountQuery(hops);
+		return next;
+	}
+	// Returns the bytes held by each component. The automaton does not keep
+	// its source text.
+	MemoryReport Memory() const
+	{
+		MemoryReport r;
+		r.states = VectorMemory(len);
+		r.states += VectorMemory(link);
+		r.states += VectorMemory(firstpos);
+		r.states += VectorMemory(clone);
+		r.states += VectorMemory(terminal);
+		r.transitions = transitions.Memory();
+		r.linktree = VectorMemory(suffixreferences);
+		for (auto& v : suffixreferences)
+		{
+			r.linktree += VectorMemory(v);
+		}
+		r.occurrences = VectorMemory(occurrences);
+		r.other = VectorMemory(terminalstates);
+		return r;
+	}
+	// Releases the spare capacity left by construction, which reserves for
+	// the worst case of 2n-1 states and grows vectors by doubling. The
+	// automaton can still be extended afterwards.
+	void ShrinkToFit()
+	{
+		len.shrink_to_fit();
+		link.shrink_to_fit();
+		firstpos.shrink_to_fit();
+		clone.shrink_to_fit();
+		terminal.shrink_to_fit();
+		transitions.ShrinkToFit();
+		for (auto& v : suffixreferences)
+		{
+			v.shrink_to_fit();
+		}
+		suffixreferences.shrink_to_fit();
+		occurrences.shrink_to_fit();
+		terminalstates.shrink_to_fit();
+	}
+	// Returns the state at index i
+	BasicState<Index> GetState(Index i) const
+	{
+		return BasicState<Index>{len[i], link[i], firstpos[i], clone[i], terminal[i]};
+	}
+	// Create a new state and return its index
+	Index AddState(Index l)
+	{
+		len.push_back(l);
+		link.push_back(-1);
+		firstpos.push_back(0);
+		clone.push_back(false);
+		terminal.push_back(false);
+		transitions.AddState();
+		if (hassuffixreferences) suffixreferences.emplace_back();
+		return len.size() - 1;
+	}
+	// Link i to l, keeping the link tree children up to date if computed
+	void SetLink(Index i, Index l)
+	{
+		link[i] = l;
+		if (hassuffixreferences) suffixreferences[l].push_back(i);
+	}
+	// Insert the new state cl between q and its parent in the link tree
+	void SplitLink(Index q, Index cl)
+	{
+		link[cl] = link[q];
+		link[q] = cl;
+		if (hassuffixreferences)
+		{
+			// cl takes q's place among its parent's children
+			auto& siblings = suffixreferences[link[cl]];
+			*find(siblings.begin(), siblings.end(), q) = cl;
+			suffixreferences[cl].push_back(q);
+		}
+	}
+	// Populate each state with a vector of its children in the link tree,
+	// which extend then keeps up to date
+	void ComputeSuffixReferences()
+	{
+		suffixreferences.assign(size(), {});
+		for (Index i = 1; i < size(); i++)
+		{
+			suffixreferences[link[i]].push_back(i);
+		}
+		hassuffixreferences = true;
+	}
+
+	// Reserve room for the automaton of an n character string, which has at
+	// most 2n-1 states and 3n-4 transitions
+	void Reserve(size_t n)
+	{
+		size_t states = max<size_t>(2 * n, 2) - 1;
+		size_t edges = max<size_t>(3 * n, 5) - 4;
+		len.reserve(states);
+		link.reserve(states);
+		firstpos.reserve(states);
+		clone.reserve(states);
+		terminal.reserve(states);
+		transitions.Reserve(states, edges);
+	}
+
+	// An automaton of the empty string, ready to be extended, optionally
+	// with a store prepared for the text to come, such as an AlphabetStore
+	// of its alphabet
+	explicit BasicSuffixAutomaton(Store store = Store())
+		: transitions(move(store))
+	{
+		AddState(0);
+		terminal[0] = true;
+		terminalstates = {0};
+		ComputeSuffixReferences();
+	}
+	// The automaton of s. If s is longer than maxtext the automaton is left
+	// empty and overflowed is set.
+	BasicSuffixAutomaton(string_view s, Store store = Store()) : BasicSuffixAutomaton(move(store))
+	{
+		if (!Fits(s.size()))
+		{
+			overflowed = true;
+			return;
+		}
+		Reserve(s.size());
+		// Building the children once at the end is cheaper than keeping them
+		// through every split
+		hassuffixreferences = false;
+		append(s);
+		MarkTerminals();
+		ComputeOccurrences();
+		ComputeSuffixReferences();
+	}
+
+	// Whether n more characters can be added without overflowing Index
+	bool Fits(size_t n) const
+	{
+		return n <= maxtext - characters;
+	}
+	// Appends every character of s to the source text. Returns false, adding
+	// nothing, if that would overflow Index.
+	bool append(string_view s)
+	{
+		if (!Fits(s.size()))
+		{
+			overflowed = true;
+			return false;
+		}
+		for (auto& c : s)
+		{
+			extend(c);
+		}
+		return true;
+	}
+
+	// Start a new document: the following extends build on the root rather
+	// than on the end of the text so far, giving a generalized automaton of
+	// every document added. Once it has been called, count, first, positions,
+	// FirstPositions and the ForEachPosition calls are wrong: they read clone
+	// flags and firstpos as positions in one text, which no longer holds
+	// across documents. Only contains stays valid, so query a generalized
+	// automaton through BasicGeneralizedSuffixAutomaton, which tracks the
+	// documents itself.
+	void StartDocument()
+	{
+		last = 0;
+		terminalsdirty = true;
+	}
+
+	// Appends c to the source text. The automaton is immediately valid for
+	// queries on the longer text. Terminal flags are left stale until the
+	// next MarkTerminals(). Returns false, adding nothing, if the automaton
+	// already holds maxtext characters.
+	bool extend(char c)
+	{
+		if (!Fits(1))
+		{
+			overflowed = true;
+			return false;
+		}
+		characters++;
+		terminalsdirty = true;
+		hasoccurrences = false;
+		// Only after StartDocument can last already have a transition through
+		// c, when this document's prefix so far also occurs in an earlier one
+		Index q = Lookup(last, c);
+		if (q != -1)
+		{
+			last = len[q] == len[last] + 1 ? q : Split(last, q, c);
+			return true;
+		}
+		// Create a new state for a new equivalence class
+		Index cur = AddState(len[last] + 1);
+		// Mark the ending position of the first occurrence of this state
+		firstpos[cur] = len[last];
+		// Keep following links until we find a transition through c
+		Index linked = last;
+		Index t = -1;
+		while (t == -1)
+		{
+			transitions.AddTransition(linked, c, cur);
+			Record(TransitionsAdded);
+			if (link[linked] != -1)
+			{
+				linked = link[linked];
+				Record(LinkClimbs);
+				t = Lookup(linked, c);
+			}
+			else // We have climbed the link tree to the root
+			{
+				// Add cur as a child of the root in the link tree and
+				// process the next character
+				SetLink(cur, 0);
+				last = cur;
+				return true;
+			}
+		}
+		// If we have reached here, we have found a state p
+		// such that p transitions through c to some state q at index t
+		Index p = linked;
+		q = t;
+		if (len[q] == len[p] + 1)
+		{
+			// Cur is a child of q in the link tree, process next character
+			SetLink(cur, q);
+			last = cur;
+			return true;
+		}
+		// Cur is not a child of q in the link tree, we must create a new
+		// state that will be the parent of both q and cur in the link tree
+		SetLink(cur, Split(p, q, c));
+		// We are finished, advance last to the new state and continue
+		last = cur;
+		return true;
+	}
+
+	// p transitions through c to q, but q also holds longer strings than
+	// p + c. Clone q into a new state holding just the strings up to
+	// len[p] + 1, make it q's parent in the link tree, redirect the
+	// transitions through c to q from p and its suffixes, and return it.
+	Index Split(Index p, Index q, char c)
+	{
+		Index cl = AddState(len[p] + 1);
+		Record(Clones);
+		transitions.CopyTransitions(cl, q);
+		firstpos[cl] = firstpos[q];
+		clone[cl] = true;
+		SplitLink(q, cl);
+
+		// Updates transitions through c to q to match our new state
+		// TODO: Double check that p needs to be updated as well
+		Index linked = p;
+		Index t = q;
+		while (t == q)
+		{
+			transitions.UpdateTransition(linked, c, cl);
+			Record(Redirects);
+			linked = link[linked];
+			if (linked != -1)
+			{
+				Record(LinkClimbs);
+				t = Lookup(linked, c);
+			}
+			else
+			{
+				break;
+			}
+		}
+		return cl;
+	}
+
+	// We now want to mark every terminal state. We start with last, as
+	// it is obviously a terminal state. By climbing the suffix links, we
+	// find the state that corresponds to the next largest suffix that
+	// is of a different equivalence class. This will be a terminal state
+	// as well. So on and so forth until we hit the root of the link tree.
+	// The previous marks are cleared first, which only costs the length of
+	// the previous chain.
+	void MarkTerminals()
+	{
+		if (!terminalsdirty) return;
+		for (auto& i : terminalstates)
+		{
+			terminal[i] = false;
+		}
+		terminalstates.clear();
+		ForEachTerminal([&](Index i)
+		{
+			terminal[i] = true;
+			terminalstates.push_back(i);
+		});
+		terminalsdirty = false;
+	}
+	// Calls f(i) for every terminal state of the text so far. It climbs the
+	// chain from last rather than reading terminal, so it holds between an
+	// append and the next MarkTerminals().
+	template <class F>
+	void ForEachTerminal(F f) const
+	{
+		for (Index i = last; i != -1; i = link[i])
+		{
+			f(i);
+		}
+	}
+
+	// O(s) query to see if our source text contains a substring s
+	bool contains(string_view s) const
+	{
+		return Walk(s) != -1;
+	}
+	// Returns the position of the first occurrence of a non-empty string s,
+	// or -1 if it does not occur
+	Index first(string_view s) const
+	{
+		Index next = Walk(s);
+		if (next == -1) return -1;
+		return firstpos[next] - s.size() + 1;
+	}
+	// Counts the occurrences of every state in O(n) for count(). The string
+	// constructor calls it once built; after append or extend, call it again
+	// before counting the longer text.
+	void ComputeOccurrences()
+	{
+		occurrences = CountOccurrences(len, link, clone);
+		hasoccurrences = true;
+	}
+	// Returns the number of occurrences of a non-empty string s in O(s), or
+	// -1 if text was added since the last ComputeOccurrences()
+	Index count(string_view s) const
+	{
+		if (!hasoccurrences) return -1;
+		Index next = Walk(s);
+		return next == -1 ? 0 : occurrences[next];
+	}
+	// Return a vector of positions where a non-empty string s occurs
+	vector<Index> positions(string_view s) const
+	{
+		vector<Index> p;
+		ForEachPosition(s, [&](Index i)
+		{
+			p.push_back(i);
+			return true;
+		});
+		sort(p.begin(), p.end());
+		return p;
+	}
+	// Calls f(i) for every position i where a non-empty string s occurs, in
+	// no particular order, until f returns false. Nothing is collected, so
+	// memory does not grow with the number of occurrences.
+	template <class F>
+	void ForEachPosition(string_view s, F f) const
+	{
+		Index sz = s.size();
+		Index next = Walk(s);
+		if (next == -1) return;
+		// Traverse link tree down from first occurrence to find all others
+		VisitLinkSubtree(next, [&](Index i) { return (int)suffixreferences[i].size(); }, [&](Index i, int j) { return suffixreferences[i][j]; }, [&](Index i)
+		{
+			Record(PositionVisits);
+			return clone[i] || f(firstpos[i] - sz + 1);
+		});
+	}
+	// As ForEachPosition, but in increasing order of position, so stopping
+	// after k calls gives the first k occurrences in the text
+	template <class F>
+	void ForEachPositionInOrder(string_view s, F f) const
+	{
+		Index sz = s.size();
+		Index next = Walk(s);
+		if (next == -1) return;
+		VisitEndsInOrder(next, firstpos.data(), [&](Index i) { return (int)suffixreferences[i].size(); }, [&](Index i, int j) { return suffixreferences[i][j]; }, [&](Index i) { return (bool)clone[i]; }, [&](Index end)
+		{
+			return f(end - sz + 1);
+		});
+	}
+	// Returns the first k positions of a non-empty string s in the text
+	vector<Index> FirstPositions(string_view s, size_t k) const
+	{
+		vector<Index> p;
+		if (k == 0) return p;
+		ForEachPositionInOrder(s, [&](Index i)
+		{
+			p.push_back(i);
+			return p.size() < k;
+		});
+		return p;
+	}
+};
+
+typedef BasicSuffixAutomaton<LinearStore> SuffixAutomaton;
+// The same layout with unsigned 32-bit indices, for texts of up to 1.4G
+// characters, twice the int limit, at no extra memory
+typedef BasicSuffixAutomaton<BasicLinearStore<uint32_t>> CompactIndexSuffixAutomaton;
+// 64-bit indices for texts beyond that, at twice the memory per index
+typedef BasicSuffixAutomaton<BasicLinearStore<int64_t>> LargeSuffixAutomaton;
+
+// An automaton with rows indexed by alphabet rank, for small alphabets such
+// as DNA. The alphabet of s is found in one pass before construction.
+inline BasicSuffixAutomaton<AlphabetStore<>> CompactSuffixAutomaton(string_view s)
+{
+	return BasicSuffixAutomaton<AlphabetStore<>>(s, AlphabetStore<>(Alphabet::Of(s)));
+}
+#endif
@@ -0,0 +1,362 @@
+#ifndef SUFFIXAUTOMATONIMAGE_H
+#define SUFFIXAUTOMATONIMAGE_H
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FrozenSuffixAutomaton.h"
+using namespace std;
+
+// On-disk image of a FrozenSuffixAutomaton, optionally with its source text.
+// Every integer is little-endian. The file is an ImageHeader followed by
+// these sections, each starting on an 8-byte boundary:
+//   len[n], link[n], firstpos[n]            index
+//   occurrences[n]                          index
+//   clonebits[w], terminalbits[w]           uint64, w = (n + 63) / 64
+//   offsets[n+1], childoffsets[n+1]         index
+//   children[n-1], targets[edges]           index
+//   labels[edges], text[textlen]            bytes
+// An index is the automaton's Index type, recorded in the header flags, and
+// an image is only mapped by an automaton of the same type. The sections are
+// exactly the arrays of a FrozenView, so a mapped image is queried in place.
+// Bump imageversion whenever this layout changes.
+const uint32_t imageversion = 4;
+
+// Header flags
+const uint32_t imagetext = 1;     // The source text is included
+const uint32_t imagewide = 2;     // Indices are 64-bit rather than 32-bit
+const uint32_t imageunsigned = 4; // Indices are unsigned
+
+template <class Index>
+uint32_t ImageIndexFlags()
+{
+	return (sizeof(Index) == 8 ? imagewide : 0) | (is_unsigned<Index>::value ? imageunsigned : 0);
+}
+
+// 40 bytes, so the first section is already aligned
+struct ImageHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t states;
+	uint64_t edges;
+	uint64_t textlen;
+};
+
+inline bool HostIsLittleEndian()
+{
+	return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+inline size_t ImageAlign(size_t x)
+{
+	return (x + 7) & ~(size_t)7;
+}
+
+// Writes count elements of T little-endian
+template <class T>
+void WriteValues(ofstream& out, const T* data, size_t count)
+{
+	if (HostIsLittleEndian())
+	{
+		out.write((const char*)data, count * sizeof(T));
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		T x = data[i];
+		char b[sizeof(T)];
+		for (size_t k = 0; k < sizeof(T); k++) b[k] = (char)((uint64_t)x >> (8 * k));
+		out.write(b, sizeof(T));
+	}
+}
+
+// Writes one section and pads it to the next 8-byte boundary
+template <class T>
+void WriteSection(ofstream& out, const T* data, size_t count)
+{
+	WriteValues(out, data, count);
+	static const char zeros[8] = {};
+	size_t bytes = count * sizeof(T);
+	out.write(zeros, ImageAlign(bytes) - bytes);
+}
+
+// Writes fa, and its source text s unless s is null, to an image at path.
+// Returns false if the file could not be written.
+template <class Index>
+bool WriteImage(const BasicFrozenSuffixAutomaton<Index>& fa, const string& path, const string_view* s)
+{
+	ofstream out(path, ios::binary);
+	if (!out.is_open()) return false;
+	BasicFrozenView<Index> v = fa.View();
+	ImageHeader h;
+	memcpy(h.magic, "SAIMAGE", 8);
+	h.version = imageversion;
+	h.flags = (s ? imagetext : 0) | ImageIndexFlags<Index>();
+	h.states = v.n;
+	h.edges = v.edges;
+	h.textlen = s ? s->size() : 0;
+	WriteValues(out, h.magic, 8);
+	WriteValues(out, &h.version, 1);
+	WriteValues(out, &h.flags, 1);
+	WriteValues(out, &h.states, 1);
+	WriteValues(out, &h.edges, 1);
+	WriteValues(out, &h.textlen, 1);
+	WriteSection(out, v.len, v.n);
+	WriteSection(out, v.link, v.n);
+	WriteSection(out, v.firstpos, v.n);
+	WriteSection(out, v.occurrences, v.n);
+	WriteSection(out, v.clonebits, v.Words(v.n));
+	WriteSection(out, v.terminalbits, v.Words(v.n));
+	WriteSection(out, v.offsets, v.n + 1);
+	WriteSection(out, v.childoffsets, v.n + 1);
+	WriteSection(out, v.children, v.n > 0 ? v.n - 1 : 0);
+	WriteSection(out, v.targets, v.edges);
+	WriteSection(out, v.labels, v.edges);
+	if (s) WriteSection(out, s->data(), s->size());
+	return out.good();
+}
+
+template <class Index>
+bool SaveImage(const BasicFrozenSuffixAutomaton<Index>& fa, const string& path)
+{
+	return WriteImage(fa, path, nullptr);
+}
+
+// Saves the source text with the automaton, so a mapped image can also
+// report the text around its matches
+template <class Index>
+bool SaveImage(const BasicFrozenSuffixAutomaton<Index>& fa, const string& path, string_view text)
+{
+	return WriteImage(fa, path, &text);
+}
+
+// A whole file mapped read-only into memory. A source text mapped this way
+// can be handed straight to the SuffixAutomaton constructor as a string_view,
+// so it is never copied into the process.
+struct MappedFile {
+	void* base = MAP_FAILED;
+	size_t bytes = 0;
+
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile()
+	{
+		Close();
+	}
+	void Close()
+	{
+		if (base != MAP_FAILED && bytes > 0) munmap(base, bytes);
+		base = MAP_FAILED;
+		bytes = 0;
+	}
+	// Maps the file at path, returning false if it cannot be opened or mapped
+	bool Open(const string& path)
+	{
+		Close();
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1) return false;
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+		{
+			close(fd);
+			return false;
+		}
+		bytes = st.st_size;
+		// An empty file cannot be mapped, but is a valid empty text
+		if (bytes > 0) base = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (bytes > 0 && base == MAP_FAILED)
+		{
+			bytes = 0;
+			return false;
+		}
+		return true;
+	}
+	const char* data() const
+	{
+		return bytes > 0 ? (const char*)base : "";
+	}
+	size_t size() const
+	{
+		return bytes;
+	}
+	string_view view() const
+	{
+		return string_view(data(), bytes);
+	}
+};
+
+// An automaton image mapped read-only into memory. Queries read the mapped
+// pages directly, so opening costs the mmap call and one pass over the states
+// and edges to validate them, and processes mapping the same file share one
+// copy in the page cache.
+template <class I = int>
+struct BasicMappedSuffixAutomaton {
+	typedef I Index;
+	BasicFrozenView<Index> view;
+	const char* text = nullptr;
+	size_t textlen = 0;
+	MappedFile file;
+
+	void Close()
+	{
+		file.Close();
+		view = BasicFrozenView<Index>();
+		text = nullptr;
+		textlen = 0;
+	}
+	// Maps the image at path. Returns false if it cannot be opened, is not an
+	// image of this version and index type, is truncated, has edge or link
+	// tree offsets out of order, has a target, link, child or count that is
+	// not below the number of states, or this host is big-endian (the image
+	// is little-endian and is never converted in place). Checking them reads
+	// those arrays once, so a corrupt image is rejected rather than crashing
+	// a later query.
+	bool Open(const string& path)
+	{
+		Close();
+		if (!HostIsLittleEndian()) return false;
+		if (!file.Open(path)) return false;
+		if (file.size() < sizeof(ImageHeader))
+		{
+			Close();
+			return false;
+		}
+		size_t bytes = file.size();
+		const char* p = file.data();
+		ImageHeader h;
+		memcpy(&h, p, sizeof(h));
+		const uint64_t limit = numeric_limits<Index>::max();
+		if (memcmp(h.magic, "SAIMAGE", 8) != 0 || h.version != imageversion || (h.flags & ~imagetext) != ImageIndexFlags<Index>() || h.states < 1 || h.states >= limit || h.edges >= limit)
+		{
+			Close();
+			return false;
+		}
+		// Every section is at most the whole file, so bounding the counts by
+		// its size first keeps the section sizes below from overflowing
+		if (h.states > bytes || h.edges > bytes || h.textlen > bytes)
+		{
+			Close();
+			return false;
+		}
+		size_t n = h.states;
+		size_t words = view.Words(n);
+		const size_t w = sizeof(Index);
+		size_t sizes[] = {w * n, w * n, w * n, w * n, 8 * words, 8 * words, w * (n + 1), w * (n + 1), w * (n - 1), w * h.edges, h.edges, h.textlen};
+		const char* sections[12];
+		size_t at = ImageAlign(sizeof(ImageHeader));
+		for (int i = 0; i < 12; i++)
+		{
+			if (at > bytes || ImageAlign(sizes[i]) > bytes - at)
+			{
+				Close();
+				return false;
+			}
+			sections[i] = p + at;
+			at += ImageAlign(sizes[i]);
+		}
+		// Queries index the edge and link tree arrays through the offsets, so
+		// those must be in bounds
+		const Index* offsets = (const Index*)sections[6];
+		const Index* childoffsets = (const Index*)sections[7];
+		bool valid = offsets[0] == 0 && offsets[n] == h.edges && childoffsets[0] == 0 && childoffsets[n] == n - 1;
+		for (size_t i = 0; i < n && valid; i++)
+		{
+			valid = offsets[i] <= offsets[i + 1] && childoffsets[i] <= childoffsets[i + 1];
+		}
+		// Every state a query can move to must exist: the root has no link, and
+		// the link tree lists every other state exactly once, so its walks end
+		const Index* link = (const Index*)sections[1];
+		const Index* occurrences = (const Index*)sections[3];
+		const Index* children = (const Index*)sections[8];
+		const Index* targets = (const Index*)sections[9];
+		for (size_t i = 0; i < n && valid; i++)
+		{
+			valid = (i == 0 ? link[i] == (Index)-1 : (uint64_t)link[i] < n) && (uint64_t)occurrences[i] < n;
+		}
+		vector<bool> listed(n, false);
+		for (size_t j = 0; j + 1 < n && valid; j++)
+		{
+			valid = children[j] != 0 && (uint64_t)children[j] < n && !listed[children[j]];
+			if (valid) listed[children[j]] = true;
+		}
+		for (size_t e = 0; e < h.edges && valid; e++)
+		{
+			valid = (uint64_t)targets[e] < n;
+		}
+		if (!valid)
+		{
+			Close();
+			return false;
+		}
+		view.n = n;
+		view.edges = h.edges;
+		view.len = (const Index*)sections[0];
+		view.link = (const Index*)sections[1];
+		view.firstpos = (const Index*)sections[2];
+		view.occurrences = (const Index*)sections[3];
+		view.clonebits = (const uint64_t*)sections[4];
+		view.terminalbits = (const uint64_t*)sections[5];
+		view.offsets = (const Index*)sections[6];
+		view.childoffsets = (const Index*)sections[7];
+		view.children = (const Index*)sections[8];
+		view.targets = (const Index*)sections[9];
+		view.labels = sections[10];
+		if (h.flags & imagetext)
+		{
+			text = sections[11];
+			textlen = h.textlen;
+		}
+		return true;
+	}
+	Index size() const
+	{
+		return view.n;
+	}
+	// Returns the bytes of each component in the mapped file. These are
+	// page cache pages shared with every process mapping the same image.
+	MemoryReport Memory() const
+	{
+		MemoryReport r;
+		size_t n = view.n, words = view.Words(view.n);
+		r.states.used = 3 * sizeof(Index) * n + 2 * sizeof(uint64_t) * words;
+		r.transitions.used = sizeof(Index) * (n + 1) + (sizeof(char) + sizeof(Index)) * view.edges;
+		r.linktree.used = sizeof(Index) * (2 * n);
+		r.occurrences.used = sizeof(Index) * n;
+		r.text.used = textlen;
+		r.other.used = file.size() - r.total().used;
+		for (MemoryUsage* m : {&r.states, &r.transitions, &r.linktree, &r.occurrences, &r.other, &r.text})
+		{
+			m->reserved = m->used;
+		}
+		return r;
+	}
+	bool contains(string_view s) const
+	{
+		return view.contains(s);
+	}
+	Index first(string_view s) const
+	{
+		return view.first(s);
+	}
+	Index count(string_view s) const
+	{
+		return view.count(s);
+	}
+	vector<Index> positions(string_view s) const
+	{
+		return view.positions(s);
+	}
+};
+typedef BasicMappedSuffixAutomaton<> MappedSuffixAutomaton;
+#endif
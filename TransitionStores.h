@@ -0,0 +1,792 @@
+#ifndef TRANSITIONSTORES_H
+#define TRANSITIONSTORES_H
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string_view>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+// Transition stores hold the out-edges of every state in an automaton. Each
+// one provides the same interface, so SuffixAutomaton can be built on any of
+// them:
+//   AddState()                 append an empty state
+//   Reserve(states, edges)     prepare room for a whole automaton
+//   GetTransition(s, c)        target of s through c, or -1
+//   AddTransition(s, c, i)     add an edge s -c-> i (c must be new to s)
+//   UpdateTransition(s, c, i)  redirect the existing edge s -c-> to i
+//   CopyTransitions(d, s)      give d an exact copy of the edges of s
+//   Degree(s)                  number of out-edges of s
+//   ForEach(s, f)              call f(c, i) for every edge of s
+//   Memory()                   bytes holding edges, and bytes allocated
+//   ShrinkToFit()              release the slack left by construction
+// States and targets are of the store's IndexType. Each store takes it as a
+// template parameter, int by default, so the automaton can trade index width
+// against the size of text it can hold.
+
+// Bytes in use, and bytes allocated including spare capacity
+struct MemoryUsage {
+	size_t used = 0;
+	size_t reserved = 0;
+	MemoryUsage& operator+=(const MemoryUsage& m)
+	{
+		used += m.used;
+		reserved += m.reserved;
+		return *this;
+	}
+};
+
+template <class T>
+MemoryUsage VectorMemory(const vector<T>& v)
+{
+	return {v.size() * sizeof(T), v.capacity() * sizeof(T)};
+}
+
+inline MemoryUsage VectorMemory(const vector<bool>& v)
+{
+	return {(v.size() + 7) / 8, (v.capacity() + 7) / 8};
+}
+
+// Returns the index of c among the n labels starting at l, or -1. Labels are
+// compared 16 at a time with SSE2, or 32 at a time when the CPU has AVX2.
+#if defined(__SSE2__)
+__attribute__((target("avx2")))
+inline int FindLabelAVX2(const char* l, int n, char c)
+{
+	__m256i needle = _mm256_set1_epi8(c);
+	int i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)(l + i));
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	for (; i < n; i++)
+	{
+		if (l[i] == c) return i;
+	}
+	return -1;
+}
+inline int FindLabelSSE2(const char* l, int n, char c)
+{
+	__m128i needle = _mm_set1_epi8(c);
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)(l + i));
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	for (; i < n; i++)
+	{
+		if (l[i] == c) return i;
+	}
+	return -1;
+}
+inline const bool hasavx2 = __builtin_cpu_supports("avx2");
+inline int FindLabel(const char* l, int n, char c)
+{
+	// Below one SSE2 block both versions are the same scalar loop
+	if (n >= 32 && hasavx2) return FindLabelAVX2(l, n, c);
+	return FindLabelSSE2(l, n, c);
+}
+#else
+inline int FindLabel(const char* l, int n, char c)
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (l[i] == c) return i;
+	}
+	return -1;
+}
+#endif
+
+// A bump allocator for edge blocks. A block of size class k holds 4 << k
+// labels followed by as many targets, so the labels of a state can be scanned
+// without touching its targets. Blocks are carved from one pool, which is
+// reserved up front and only reallocated if that estimate is exceeded. A
+// block that is outgrown goes on the free list for its class and is handed
+// out again before the pool is bumped.
+//
+// A block is addressed by its offset into the pool, as an Index, counted in
+// units of the smallest block whenever every block is a multiple of it. With
+// 32-bit indices that lets an Index reach 20 times further into the pool.
+template <class Index>
+class EdgeArena {
+	static const int classes = 7; // 4 to 256 edges, enough for every byte
+	vector<char> pool;
+	vector<Index> freelist[classes];
+public:
+	static int Capacity(int k)
+	{
+		return 4 << k;
+	}
+	// Labels are padded so the targets after them stay aligned
+	static constexpr size_t LabelBytes(int k)
+	{
+		return ((4 << k) + sizeof(Index) - 1) / sizeof(Index) * sizeof(Index);
+	}
+	static constexpr size_t Bytes(int k)
+	{
+		return LabelBytes(k) + (4 << k) * sizeof(Index);
+	}
+	static constexpr size_t unit = Bytes(1) % Bytes(0) == 0 ? Bytes(0) : 1;
+	void Reserve(size_t bytes)
+	{
+		pool.reserve(bytes);
+	}
+	Index Allocate(int k)
+	{
+		if (!freelist[k].empty())
+		{
+			Index b = freelist[k].back();
+			freelist[k].pop_back();
+			return b;
+		}
+		Index b = pool.size() / unit;
+		pool.resize(pool.size() + Bytes(k));
+		return b;
+	}
+	void Free(Index b, int k)
+	{
+		freelist[k].push_back(b);
+	}
+	// Blocks on the free lists count as allocated but not used
+	MemoryUsage Memory() const
+	{
+		MemoryUsage m{pool.size(), pool.capacity()};
+		for (int k = 0; k < classes; k++)
+		{
+			m.used -= freelist[k].size() * Bytes(k);
+			m.reserved += freelist[k].capacity() * sizeof(Index);
+		}
+		return m;
+	}
+	// The smallest class holding n edges
+	static int ClassOf(int n)
+	{
+		int k = 0;
+		while (Capacity(k) < n) k++;
+		return k;
+	}
+	char* Labels(Index b)
+	{
+		return &pool[(size_t)b * unit];
+	}
+	const char* Labels(Index b) const
+	{
+		return &pool[(size_t)b * unit];
+	}
+	Index* Targets(Index b, int k)
+	{
+		return (Index*)&pool[(size_t)b * unit + LabelBytes(k)];
+	}
+	const Index* Targets(Index b, int k) const
+	{
+		return (const Index*)&pool[(size_t)b * unit + LabelBytes(k)];
+	}
+};
+
+// Unsorted edge blocks from an EdgeArena, searched linearly with FindLabel.
+// Cheapest to build and usually the fastest for the small degrees found in
+// most states.
+template <class Index = int>
+struct BasicLinearStore {
+	typedef Index IndexType;
+	struct EdgeList {
+		Index block = -1;
+		short n = 0;
+		short k = 0;
+	};
+	vector<EdgeList> transitions;
+	EdgeArena<Index> arena;
+	void AddState()
+	{
+		transitions.emplace_back();
+	}
+	void Reserve(size_t states, size_t edges)
+	{
+		transitions.reserve(states);
+		// Most states end up with one or two edges in the smallest class
+		arena.Reserve(EdgeArena<Index>::Bytes(0) * states + (sizeof(char) + sizeof(Index)) * edges);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		const EdgeList& e = transitions[s];
+		if (e.n == 0) return -1;
+		int j = FindLabel(arena.Labels(e.block), e.n, c);
+		return j == -1 ? -1 : arena.Targets(e.block, e.k)[j];
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		EdgeList& e = transitions[s];
+		if (e.block == -1)
+		{
+			e.block = arena.Allocate(0);
+		}
+		else if (e.n == EdgeArena<Index>::Capacity(e.k))
+		{
+			// Move to a block of the next class up and recycle this one
+			Index b = arena.Allocate(e.k + 1);
+			copy(arena.Labels(e.block), arena.Labels(e.block) + e.n, arena.Labels(b));
+			copy(arena.Targets(e.block, e.k), arena.Targets(e.block, e.k) + e.n, arena.Targets(b, e.k + 1));
+			arena.Free(e.block, e.k);
+			e.block = b;
+			e.k++;
+		}
+		arena.Labels(e.block)[e.n] = c;
+		arena.Targets(e.block, e.k)[e.n] = i;
+		e.n++;
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		const EdgeList& e = transitions[s];
+		if (e.n == 0) return;
+		int j = FindLabel(arena.Labels(e.block), e.n, c);
+		if (j != -1) arena.Targets(e.block, e.k)[j] = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		EdgeList e = transitions[s];
+		if (e.n == 0) return;
+		Index b = arena.Allocate(e.k);
+		// Allocate may have moved the pool, so only take pointers afterwards
+		copy(arena.Labels(e.block), arena.Labels(e.block) + EdgeArena<Index>::Bytes(e.k), arena.Labels(b));
+		e.block = b;
+		transitions[d] = e;
+	}
+	int Degree(Index s) const
+	{
+		return transitions[s].n;
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		const EdgeList& e = transitions[s];
+		if (e.n == 0) return;
+		const char* l = arena.Labels(e.block);
+		const Index* t = arena.Targets(e.block, e.k);
+		for (int j = 0; j < e.n; j++) f(l[j], t[j]);
+	}
+	// Used bytes count only live edges, not the empty slots of their blocks
+	MemoryUsage Memory() const
+	{
+		MemoryUsage m = VectorMemory(transitions);
+		for (auto& e : transitions)
+		{
+			m.used += e.n * (sizeof(char) + sizeof(Index));
+		}
+		m.reserved += arena.Memory().reserved;
+		return m;
+	}
+	// Repack every state into the smallest block that holds its edges, in
+	// state order, in a pool of exactly the bytes needed. This drops the
+	// free lists and the blocks that clones copied at their source's size.
+	void ShrinkToFit()
+	{
+		size_t bytes = 0;
+		for (auto& e : transitions)
+		{
+			if (e.n > 0) bytes += EdgeArena<Index>::Bytes(EdgeArena<Index>::ClassOf(e.n));
+		}
+		EdgeArena<Index> packed;
+		packed.Reserve(bytes);
+		for (auto& e : transitions)
+		{
+			if (e.n == 0) continue;
+			int k = EdgeArena<Index>::ClassOf(e.n);
+			Index b = packed.Allocate(k);
+			copy(arena.Labels(e.block), arena.Labels(e.block) + e.n, packed.Labels(b));
+			copy(arena.Targets(e.block, e.k), arena.Targets(e.block, e.k) + e.n, packed.Targets(b, k));
+			e.block = b;
+			e.k = k;
+		}
+		arena = move(packed);
+		transitions.shrink_to_fit();
+	}
+};
+typedef BasicLinearStore<> LinearStore;
+
+// Vector per state kept sorted by label and searched with a binary search.
+// Edges are visited in label order.
+template <class Index = int>
+struct BasicSortedStore {
+	typedef Index IndexType;
+	typedef pair<char, Index> Edge;
+	vector<vector<Edge>> transitions;
+	static bool Less(const Edge& t, char c)
+	{
+		return (unsigned char)t.first < (unsigned char)c;
+	}
+	void AddState()
+	{
+		transitions.emplace_back();
+	}
+	void Reserve(size_t states, size_t)
+	{
+		transitions.reserve(states);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		auto& v = transitions[s];
+		auto it = lower_bound(v.begin(), v.end(), c, Less);
+		if (it != v.end() && it->first == c) return it->second;
+		return -1;
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		auto& v = transitions[s];
+		v.insert(lower_bound(v.begin(), v.end(), c, Less), Edge(c, i));
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		auto& v = transitions[s];
+		auto it = lower_bound(v.begin(), v.end(), c, Less);
+		if (it != v.end() && it->first == c) it->second = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		transitions[d] = transitions[s];
+	}
+	int Degree(Index s) const
+	{
+		return transitions[s].size();
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		for (auto& t : transitions[s]) f(t.first, t.second);
+	}
+	MemoryUsage Memory() const
+	{
+		MemoryUsage m = VectorMemory(transitions);
+		for (auto& v : transitions)
+		{
+			m += VectorMemory(v);
+		}
+		return m;
+	}
+	void ShrinkToFit()
+	{
+		for (auto& v : transitions)
+		{
+			v.shrink_to_fit();
+		}
+		transitions.shrink_to_fit();
+	}
+};
+typedef BasicSortedStore<> SortedStore;
+
+// std::map per state, as used by the original MapTiming driver.
+template <class Index = int>
+struct BasicMapStore {
+	typedef Index IndexType;
+	vector<map<char, Index>> transitions;
+	void AddState()
+	{
+		transitions.emplace_back();
+	}
+	void Reserve(size_t states, size_t)
+	{
+		transitions.reserve(states);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		auto it = transitions[s].find(c);
+		if (it == transitions[s].end()) return -1;
+		return it->second;
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		transitions[s][c] = i;
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		transitions[s][c] = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		transitions[d] = transitions[s];
+	}
+	int Degree(Index s) const
+	{
+		return transitions[s].size();
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		for (auto& t : transitions[s]) f(t.first, t.second);
+	}
+	// Each edge is a tree node of three pointers and a colour besides the
+	// pair itself; allocator headers are not counted
+	MemoryUsage Memory() const
+	{
+		const size_t node = 4 * sizeof(void*) + sizeof(pair<const char, Index>);
+		MemoryUsage m = VectorMemory(transitions);
+		for (auto& t : transitions)
+		{
+			m.used += t.size() * node;
+			m.reserved += t.size() * node;
+		}
+		return m;
+	}
+	void ShrinkToFit()
+	{
+		transitions.shrink_to_fit();
+	}
+};
+typedef BasicMapStore<> MapStore;
+
+// A full 256-entry table per state: lookups are a single index, but every
+// state costs 1KB. Only sensible for small texts or benchmarking.
+template <class Index = int>
+struct BasicDenseStore {
+	typedef Index IndexType;
+	vector<Index> table;
+	vector<int> degree;
+	void AddState()
+	{
+		table.resize(table.size() + 256, -1);
+		degree.push_back(0);
+	}
+	void Reserve(size_t states, size_t)
+	{
+		table.reserve((size_t)states * 256);
+		degree.reserve(states);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		return table[(size_t)s * 256 + (unsigned char)c];
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		table[(size_t)s * 256 + (unsigned char)c] = i;
+		degree[s]++;
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		table[(size_t)s * 256 + (unsigned char)c] = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		copy(table.begin() + (size_t)s * 256, table.begin() + (size_t)(s + 1) * 256, table.begin() + (size_t)d * 256);
+		degree[d] = degree[s];
+	}
+	int Degree(Index s) const
+	{
+		return degree[s];
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		for (int c = 0; c < 256; c++)
+		{
+			Index t = table[(size_t)s * 256 + c];
+			if (t != -1) f((char)c, t);
+		}
+	}
+	// Only the table entries holding an edge count as used
+	MemoryUsage Memory() const
+	{
+		MemoryUsage m = VectorMemory(degree);
+		for (auto& d : degree)
+		{
+			m.used += d * sizeof(Index);
+		}
+		m.reserved += VectorMemory(table).reserved;
+		return m;
+	}
+	void ShrinkToFit()
+	{
+		table.shrink_to_fit();
+		degree.shrink_to_fit();
+	}
+};
+typedef BasicDenseStore<> DenseStore;
+
+// Linear vectors for most states, but any state whose degree reaches
+// Threshold is promoted to its own 256-entry table. In natural text this
+// catches the root and the handful of hub states near it, which are the ones
+// the construction loop searches most often.
+template <class Index = int, int Threshold = 16>
+struct HybridStore {
+	typedef Index IndexType;
+	BasicLinearStore<Index> sparse;
+	vector<Index> dense; // Index of the state's table in tables, or -1
+	vector<Index> tables;
+	void AddState()
+	{
+		sparse.AddState();
+		dense.push_back(-1);
+	}
+	void Reserve(size_t states, size_t edges)
+	{
+		sparse.Reserve(states, edges);
+		dense.reserve(states);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		if (dense[s] != -1) return tables[(size_t)dense[s] * 256 + (unsigned char)c];
+		return sparse.GetTransition(s, c);
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		sparse.AddTransition(s, c, i);
+		if (dense[s] != -1)
+		{
+			tables[(size_t)dense[s] * 256 + (unsigned char)c] = i;
+		}
+		else if (sparse.Degree(s) >= Threshold)
+		{
+			Promote(s);
+		}
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		sparse.UpdateTransition(s, c, i);
+		if (dense[s] != -1) tables[(size_t)dense[s] * 256 + (unsigned char)c] = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		sparse.CopyTransitions(d, s);
+		if (dense[s] != -1) Promote(d);
+	}
+	int Degree(Index s) const
+	{
+		return sparse.Degree(s);
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		sparse.ForEach(s, f);
+	}
+	// The dense tables duplicate edges already counted in sparse
+	MemoryUsage Memory() const
+	{
+		MemoryUsage m = sparse.Memory();
+		m += VectorMemory(dense);
+		m.reserved += VectorMemory(tables).reserved;
+		return m;
+	}
+	void ShrinkToFit()
+	{
+		sparse.ShrinkToFit();
+		dense.shrink_to_fit();
+		tables.shrink_to_fit();
+	}
+	// Give s a dense table built from its sparse edges
+	void Promote(Index s)
+	{
+		if (dense[s] == -1)
+		{
+			dense[s] = tables.size() / 256;
+			tables.resize(tables.size() + 256, -1);
+		}
+		Index* table = &tables[(size_t)dense[s] * 256];
+		sparse.ForEach(s, [&](char c, Index t)
+		{
+			table[(unsigned char)c] = t;
+		});
+	}
+};
+
+// The bytes that occur in a text, numbered 0 to size()-1 in the order they
+// were added: Of numbers the bytes of a text in increasing order of byte
+// value, and Add gives a byte first seen later the next rank after them
+struct Alphabet {
+	short rank[256];
+	vector<unsigned char> bytes;
+
+	Alphabet()
+	{
+		fill(rank, rank + 256, -1);
+	}
+	static Alphabet Of(string_view s)
+	{
+		bool seen[256] = {};
+		for (auto& c : s)
+		{
+			seen[(unsigned char)c] = true;
+		}
+		Alphabet a;
+		for (int b = 0; b < 256; b++)
+		{
+			if (seen[b]) a.Add(b);
+		}
+		return a;
+	}
+	int size() const
+	{
+		return bytes.size();
+	}
+	// Returns the rank of c, or -1 if it is not in the alphabet
+	int Rank(char c) const
+	{
+		return rank[(unsigned char)c];
+	}
+	// Adds a byte that is not yet in the alphabet and returns its rank
+	int Add(char c)
+	{
+		rank[(unsigned char)c] = bytes.size();
+		bytes.push_back(c);
+		return bytes.size() - 1;
+	}
+};
+
+// Transitions indexed by the rank of their label in an Alphabet. While the
+// alphabet has at most MaxDense bytes, every state has a fixed row of width
+// targets, so a lookup is one index with no search, and a row of a DNA
+// automaton is 16 or 32 bytes. Larger alphabets keep sparse LinearStore
+// edges. Either way a byte outside the alphabet fails without touching the
+// state.
+//
+// Pass Alphabet::Of(text) to the constructor to size the rows before
+// construction. A default constructed store, or a byte first seen by a later
+// extend, adds to the alphabet as it goes: rows are widened by doubling, and
+// the store turns sparse once the alphabet outgrows MaxDense.
+template <class Index = int, int MaxDense = 16>
+struct AlphabetStore {
+	static_assert(MaxDense < 256, "A dense row's degree is kept in one byte");
+	typedef Index IndexType;
+	Alphabet alphabet;
+	int width = 4; // Targets per row, or 0 once sparse
+	vector<Index> table;
+	vector<unsigned char> degree;
+	BasicLinearStore<Index> sparse;
+
+	AlphabetStore() {}
+	AlphabetStore(const Alphabet& a)
+		: alphabet(a)
+	{
+		width = a.size() <= MaxDense ? max(a.size(), 1) : 0;
+	}
+	void AddState()
+	{
+		if (width == 0)
+		{
+			sparse.AddState();
+			return;
+		}
+		table.resize(table.size() + width, -1);
+		degree.push_back(0);
+	}
+	void Reserve(size_t states, size_t edges)
+	{
+		if (width == 0)
+		{
+			sparse.Reserve(states, edges);
+			return;
+		}
+		table.reserve((size_t)states * width);
+		degree.reserve(states);
+	}
+	Index GetTransition(Index s, char c) const
+	{
+		int r = alphabet.Rank(c);
+		if (r == -1) return -1;
+		if (width == 0) return sparse.GetTransition(s, c);
+		return table[(size_t)s * width + r];
+	}
+	void AddTransition(Index s, char c, Index i)
+	{
+		int r = alphabet.Rank(c);
+		if (r == -1)
+		{
+			r = alphabet.Add(c);
+			if (width != 0 && r >= width) Widen();
+		}
+		if (width == 0)
+		{
+			sparse.AddTransition(s, c, i);
+			return;
+		}
+		table[(size_t)s * width + r] = i;
+		degree[s]++;
+	}
+	void UpdateTransition(Index s, char c, Index i)
+	{
+		int r = alphabet.Rank(c);
+		if (r == -1) return;
+		if (width == 0) sparse.UpdateTransition(s, c, i);
+		else if (table[(size_t)s * width + r] != -1) table[(size_t)s * width + r] = i;
+	}
+	void CopyTransitions(Index d, Index s)
+	{
+		if (width == 0)
+		{
+			sparse.CopyTransitions(d, s);
+			return;
+		}
+		copy(table.begin() + (size_t)s * width, table.begin() + (size_t)(s + 1) * width, table.begin() + (size_t)d * width);
+		degree[d] = degree[s];
+	}
+	int Degree(Index s) const
+	{
+		return width == 0 ? sparse.Degree(s) : degree[s];
+	}
+	template <class F>
+	void ForEach(Index s, F f) const
+	{
+		if (width == 0)
+		{
+			sparse.ForEach(s, f);
+			return;
+		}
+		// A byte being added may already have a rank beyond the row
+		const Index* row = &table[(size_t)s * width];
+		for (int r = 0; r < width; r++)
+		{
+			if (row[r] != -1) f((char)alphabet.bytes[r], row[r]);
+		}
+	}
+	// Move to rows wide enough for the whole alphabet, or to sparse edges
+	// once it has more than MaxDense bytes
+	void Widen()
+	{
+		size_t states = degree.size();
+		if (alphabet.size() > MaxDense)
+		{
+			BasicLinearStore<Index> edges;
+			edges.Reserve(states, 0);
+			for (size_t s = 0; s < states; s++)
+			{
+				edges.AddState();
+				ForEach(s, [&](char c, Index t) { edges.AddTransition(s, c, t); });
+			}
+			sparse = move(edges);
+			width = 0;
+			vector<Index>().swap(table);
+			vector<unsigned char>().swap(degree);
+			return;
+		}
+		int wider = min(max(2 * width, alphabet.size()), MaxDense);
+		vector<Index> rows(states * wider, -1);
+		for (size_t s = 0; s < states; s++)
+		{
+			copy(table.begin() + (size_t)s * width, table.begin() + (size_t)(s + 1) * width, rows.begin() + (size_t)s * wider);
+		}
+		table.swap(rows);
+		width = wider;
+	}
+	// Only the row entries holding an edge count as used
+	MemoryUsage Memory() const
+	{
+		if (width == 0) return sparse.Memory();
+		MemoryUsage m = VectorMemory(degree);
+		for (auto& d : degree)
+		{
+			m.used += d * sizeof(Index);
+		}
+		m.reserved += VectorMemory(table).reserved;
+		return m;
+	}
+	void ShrinkToFit()
+	{
+		sparse.ShrinkToFit();
+		table.shrink_to_fit();
+		degree.shrink_to_fit();
+	}
+};
+#endif
@@ -0,0 +1,154 @@
+#ifndef WAVELETMATRIX_H
+#define WAVELETMATRIX_H
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// A bit vector with O(1) rank, keeping the number of ones before every
+// 64-bit word. Ranks are of the Index type of the sequence it belongs to.
+template <class Index = int>
+struct BasicRankBitVector {
+	vector<uint64_t> words;
+	vector<Index> ranks;
+	void Build(const vector<bool>& bits)
+	{
+		words.assign(bits.size() / 64 + 1, 0);
+		for (size_t i = 0; i < bits.size(); i++)
+		{
+			if (bits[i]) words[i >> 6] |= (uint64_t)1 << (i & 63);
+		}
+		ranks.assign(words.size() + 1, 0);
+		for (size_t w = 0; w < words.size(); w++)
+		{
+			ranks[w + 1] = ranks[w] + __builtin_popcountll(words[w]);
+		}
+	}
+	// Number of ones in [0, i)
+	Index Rank1(Index i) const
+	{
+		uint64_t mask = ((uint64_t)1 << (i & 63)) - 1;
+		return ranks[i >> 6] + __builtin_popcountll(words[i >> 6] & mask);
+	}
+	Index Rank0(Index i) const
+	{
+		return i - Rank1(i);
+	}
+};
+typedef BasicRankBitVector<> RankBitVector;
+
+// A wavelet matrix over a sequence of values in [0, 2^levels). Any slice
+// [l, r) of the sequence can be counted or enumerated by value without
+// touching the values outside it: counting values in a range costs
+// O(levels), and enumerating the values of a slice in increasing order costs
+// O(levels) per value reported, with whole subtrees skipped for paging.
+// Values, positions and counts are all of the Index type.
+template <class Index = int>
+struct BasicWaveletMatrix {
+	Index n = 0;
+	int levels = 0;
+	vector<BasicRankBitVector<Index>> bits;
+	vector<Index> zeros;
+
+	BasicWaveletMatrix() {}
+	BasicWaveletMatrix(vector<Index> values, Index maxvalue)
+	{
+		n = values.size();
+		levels = 1;
+		while ((1LL << levels) <= (int64_t)maxvalue) levels++;
+		bits.resize(levels);
+		zeros.resize(levels);
+		vector<Index> next(n);
+		vector<bool> b(n);
+		for (int k = 0; k < levels; k++)
+		{
+			int shift = levels - 1 - k;
+			Index z = 0;
+			for (Index i = 0; i < n; i++)
+			{
+				b[i] = values[i] >> shift & 1;
+				if (!b[i]) z++;
+			}
+			bits[k].Build(b);
+			zeros[k] = z;
+			// Stable partition: values with a 0 at this bit first
+			Index zi = 0, oi = z;
+			for (Index i = 0; i < n; i++)
+			{
+				if (b[i]) next[oi++] = values[i];
+				else next[zi++] = values[i];
+			}
+			values.swap(next);
+		}
+	}
+	// Number of values in slice [l, r) that are less than x
+	Index CountLess(Index l, Index r, int64_t x) const
+	{
+		if (x >= (1LL << levels)) return r - l;
+		if (x <= 0) return 0;
+		Index result = 0;
+		for (int k = 0; k < levels && l < r; k++)
+		{
+			int shift = levels - 1 - k;
+			Index l0 = bits[k].Rank0(l), r0 = bits[k].Rank0(r);
+			if (x >> shift & 1)
+			{
+				result += r0 - l0;
+				l = zeros[k] + (l - l0);
+				r = zeros[k] + (r - r0);
+			}
+			else
+			{
+				l = l0;
+				r = r0;
+			}
+		}
+		return result;
+	}
+	// Number of values in slice [l, r) within [lo, hi)
+	Index CountRange(Index l, Index r, int64_t lo, int64_t hi) const
+	{
+		if (lo >= hi) return 0;
+		return CountLess(l, r, hi) - CountLess(l, r, lo);
+	}
+	// Calls f(v) for the values v of slice [l, r) within [lo, hi), in
+	// increasing order, after skipping the first skip of them. Stops early,
+	// returning false, as soon as f returns false.
+	template <class F>
+	bool Enumerate(Index l, Index r, int64_t lo, int64_t hi, int64_t& skip, F f) const
+	{
+		return Enumerate(0, 0, l, r, lo, hi, skip, f);
+	}
+private:
+	template <class F>
+	bool Enumerate(int k, int64_t prefix, Index l, Index r, int64_t lo, int64_t hi, int64_t& skip, F& f) const
+	{
+		if (l >= r) return true;
+		// This node holds every value with the top k bits of prefix
+		int shift = levels - k;
+		int64_t first = prefix << shift, last = first + (1LL << shift);
+		if (last <= lo || first >= hi) return true;
+		if (lo <= first && last <= hi && skip >= r - l)
+		{
+			skip -= r - l;
+			return true;
+		}
+		if (k == levels)
+		{
+			for (Index i = l; i < r; i++)
+			{
+				if (skip > 0)
+				{
+					skip--;
+					continue;
+				}
+				if (!f((Index)prefix)) return false;
+			}
+			return true;
+		}
+		Index l0 = bits[k].Rank0(l), r0 = bits[k].Rank0(r);
+		if (!Enumerate(k + 1, prefix << 1, l0, r0, lo, hi, skip, f)) return false;
+		return Enumerate(k + 1, prefix << 1 | 1, zeros[k] + (l - l0), zeros[k] + (r - r0), lo, hi, skip, f);
+	}
+};
+typedef BasicWaveletMatrix<> WaveletMatrix;
+#endif